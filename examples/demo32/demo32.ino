@@ -158,7 +158,7 @@ void setup() {
   conf.readConfig();
   initWiFi();
   char dns[30];
-  sprintf(dns, "%s.local", conf.getDeviceName());
+  snprintf(dns, sizeof(dns), "%s.local", conf.getDeviceName());
   if (MDNS.begin(dns)) {
     Serial.println("MDNS responder gestartet");
   }
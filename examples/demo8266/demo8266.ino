@@ -163,7 +163,7 @@ void setup() {
   conf.readConfig();
   initWiFi();
   char dns[30];
-  sprintf(dns,"%s.local",conf.getApName());
+  snprintf(dns,sizeof(dns),"%s.local",conf.getApName());
   if (MDNS.begin(dns)) {
     Serial.println("MDNS responder gestartet");
   }
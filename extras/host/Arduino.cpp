@@ -0,0 +1,114 @@
+/*
+File Arduino.cpp
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+Description
+Implementation of the minimal Arduino core for a Linux host
+*/
+
+#include "Arduino.h"
+#include <stdarg.h>
+#include <chrono>
+#include <thread>
+
+HostSerial Serial;
+
+#if !defined(__GLIBC__) || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+  size_t len = strlen(src);
+  if (size > 0)
+  {
+    size_t n = (len < size - 1) ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = 0;
+  }
+  return len;
+}
+#endif
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+  if (from > to)
+    std::swap(from, to);
+  if (from >= _s.size())
+    return String();
+  return String(_s.substr(from, to - from));
+}
+
+void String::replace(const String &find, const String &replace)
+{
+  if (find._s.empty())
+    return;
+  size_t pos = 0;
+  while ((pos = _s.find(find._s, pos)) != std::string::npos)
+  {
+    _s.replace(pos, find._s.size(), replace._s);
+    pos += replace._s.size();
+  }
+}
+
+void String::trim()
+{
+  size_t first = _s.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos)
+  {
+    _s.clear();
+    return;
+  }
+  _s = _s.substr(first, _s.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+void String::setFloat(double v, unsigned int decimals)
+{
+  char buf[40];
+  snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+  _s = buf;
+}
+
+size_t HostSerial::printf(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int n = vfprintf(stderr, format, args);
+  va_end(args);
+  return (n > 0) ? n : 0;
+}
+
+static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+unsigned long millis()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned long micros()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void delay(unsigned long ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield()
+{
+  std::this_thread::yield();
+}
+
+long random(long max)
+{
+  return (max > 0) ? ::random() % max : 0;
+}
+
+long random(long min, long max)
+{
+  return (max > min) ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed)
+{
+  srandom(seed);
+}
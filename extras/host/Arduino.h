@@ -0,0 +1,199 @@
+/*
+
+File Arduino.h
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+
+Description
+Minimal Arduino core for a Linux host. It provides what the WebConfig
+sources use (String, Print, Stream, Serial, millis, random and the
+PROGMEM functions), so the library can be compiled unchanged for host
+tools and tests.
+ArduinoJson has to be built with ARDUINOJSON_ENABLE_ARDUINO_STRING=1
+and without Arduino streams and PROGMEM, see the Makefiles in extras.
+
+*/
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+//flash strings are normal strings on the host
+#define PROGMEM
+#define F(s) (s)
+#define PSTR(s) (s)
+#define FPSTR(s) (s)
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define memcpy_P memcpy
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+
+#if !defined(__GLIBC__) || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+size_t strlcpy(char* dst, const char* src, size_t size);
+#endif
+
+class String {
+  public:
+  String() {}
+  String(const char* s) : _s(s ? s : "") {}
+  String(const std::string& s) : _s(s) {}
+  explicit String(char c) : _s(1, c) {}
+  explicit String(int v) : _s(std::to_string(v)) {}
+  explicit String(unsigned int v) : _s(std::to_string(v)) {}
+  explicit String(long v) : _s(std::to_string(v)) {}
+  explicit String(unsigned long v) : _s(std::to_string(v)) {}
+  explicit String(float v, unsigned int decimals = 2) { setFloat(v, decimals); }
+  explicit String(double v, unsigned int decimals = 2) { setFloat(v, decimals); }
+  const char* c_str() const { return _s.c_str(); }
+  unsigned int length() const { return _s.size(); }
+  boolean reserve(unsigned int size) { _s.reserve(size); return true; }
+  boolean concat(const String& s) { _s += s._s; return true; }
+  boolean concat(const char* s) { if (s) _s += s; return true; }
+  boolean concat(const char* s, unsigned int len) { _s.append(s, len); return true; }
+  boolean concat(char c) { _s += c; return true; }
+  String& operator+=(const String& s) { _s += s._s; return *this; }
+  String& operator+=(const char* s) { concat(s); return *this; }
+  String& operator+=(char c) { _s += c; return *this; }
+  String& operator+=(int v) { _s += std::to_string(v); return *this; }
+  String& operator+=(unsigned int v) { _s += std::to_string(v); return *this; }
+  String& operator+=(long v) { _s += std::to_string(v); return *this; }
+  String& operator+=(unsigned long v) { _s += std::to_string(v); return *this; }
+  boolean operator==(const String& s) const { return _s == s._s; }
+  boolean operator==(const char* s) const { return _s == (s ? s : ""); }
+  boolean operator!=(const String& s) const { return _s != s._s; }
+  boolean operator!=(const char* s) const { return !(*this == s); }
+  boolean operator<(const String& s) const { return _s < s._s; }
+  char operator[](unsigned int i) const { return (i < _s.size()) ? _s[i] : 0; }
+  char& operator[](unsigned int i) { return _s[i]; }
+  char charAt(unsigned int i) const { return (*this)[i]; }
+  void setCharAt(unsigned int i, char c) { if (i < _s.size()) _s[i] = c; }
+  boolean equals(const String& s) const { return _s == s._s; }
+  boolean isEmpty() const { return _s.empty(); }
+  boolean startsWith(const String& s) const { return _s.compare(0, s._s.size(), s._s) == 0; }
+  boolean endsWith(const String& s) const { return (_s.size() >= s._s.size()) && (_s.compare(_s.size() - s._s.size(), s._s.size(), s._s) == 0); }
+  int indexOf(char c, unsigned int from = 0) const { return find(_s.find(c, from)); }
+  int indexOf(const String& s, unsigned int from = 0) const { return find(_s.find(s._s, from)); }
+  int lastIndexOf(char c) const { return find(_s.rfind(c)); }
+  String substring(unsigned int from) const { return (from < _s.size()) ? String(_s.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const;
+  void replace(const String& find, const String& replace);
+  void replace(char find, char replace) { std::replace(_s.begin(), _s.end(), find, replace); }
+  void remove(unsigned int index) { if (index < _s.size()) _s.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < _s.size()) _s.erase(index, count); }
+  void trim();
+  void toLowerCase() { for (char& c : _s) c = tolower(c); }
+  void toUpperCase() { for (char& c : _s) c = toupper(c); }
+  long toInt() const { return atol(_s.c_str()); }
+  float toFloat() const { return atof(_s.c_str()); }
+  double toDouble() const { return atof(_s.c_str()); }
+  private:
+  std::string _s;
+  static int find(size_t pos) { return (pos == std::string::npos) ? -1 : (int)pos; }
+  void setFloat(double v, unsigned int decimals);
+};
+
+//result type of String concatenations, ArduinoJson refers to it
+class StringSumHelper : public String {
+  public:
+  StringSumHelper(const String& s) : String(s) {}
+};
+
+inline StringSumHelper operator+(const String& a, const String& b)
+{
+  StringSumHelper r(a);
+  r += b;
+  return r;
+}
+inline StringSumHelper operator+(const String& a, const char* b)
+{
+  StringSumHelper r(a);
+  r += b;
+  return r;
+}
+inline StringSumHelper operator+(const char* a, const String& b)
+{
+  StringSumHelper r(a);
+  r += b;
+  return r;
+}
+inline StringSumHelper operator+(const String& a, char b)
+{
+  StringSumHelper r(a);
+  r += b;
+  return r;
+}
+
+//byte sinks and sources of the binary results
+class Print {
+  public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size)
+  {
+    size_t n = 0;
+    while (size-- > 0)
+      n += write(*buffer++);
+    return n;
+  }
+};
+
+class Stream : public Print {
+  public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  //reads until length bytes are read or the source is empty
+  size_t readBytes(char* buffer, size_t length)
+  {
+    size_t n = 0;
+    int c;
+    while ((n < length) && ((c = read()) >= 0))
+      buffer[n++] = c;
+    return n;
+  }
+  size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+};
+
+//Serial writes to stderr, so tools can use stdout for their output
+class HostSerial {
+  public:
+  void begin(unsigned long baud) {}
+  size_t print(const String& s) { return fputs(s.c_str(), stderr) >= 0 ? s.length() : 0; }
+  size_t print(const char* s) { return print(String(s)); }
+  size_t print(char c) { return fputc(c, stderr) != EOF; }
+  size_t print(int v) { return print(String(v)); }
+  size_t print(unsigned int v) { return print(String(v)); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned long v) { return print(String(v)); }
+  size_t print(double v, int decimals = 2) { return print(String(v, decimals)); }
+  template <typename T>
+  size_t println(const T& v) { return print(v) + print('\n'); }
+  size_t println() { return print('\n'); }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+extern HostSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+#endif
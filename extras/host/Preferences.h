@@ -0,0 +1,101 @@
+/*
+
+File Preferences.h
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+
+Description
+The part of the Preferences class of the ESP32 core NVSStorage uses,
+on top of the NVS emulation in nvs.h. Doubles, floats and byte arrays
+are blobs like on the ESP32.
+
+*/
+#ifndef Preferences_h
+#define Preferences_h
+
+#include "Arduino.h"
+#include "nvs.h"
+
+class Preferences {
+  public:
+  ~Preferences() { end(); }
+  bool begin(const char* name, bool readOnly = false)
+  {
+    if (_open)
+      return false;
+    _open = nvs_open(name, readOnly ? NVS_READONLY : NVS_READWRITE, &_handle) == ESP_OK;
+    return _open;
+  }
+  void end()
+  {
+    if (_open)
+      nvs_close(_handle);
+    _open = false;
+  }
+  bool clear() { return _open && (nvs_erase_all(_handle) == ESP_OK) && (nvs_commit(_handle) == ESP_OK); }
+  bool remove(const char* key) { return _open && (nvs_erase_key(_handle, key) == ESP_OK) && (nvs_commit(_handle) == ESP_OK); }
+  bool isKey(const char* key)
+  {
+    int32_t i;
+    size_t len;
+    return _open && ((nvs_get_i32(_handle, key, &i) == ESP_OK) ||
+                     (nvs_get_str(_handle, key, nullptr, &len) == ESP_OK) ||
+                     (nvs_get_blob(_handle, key, nullptr, &len) == ESP_OK));
+  }
+  int32_t getInt(const char* key, int32_t defaultValue = 0)
+  {
+    int32_t value = defaultValue;
+    if (_open)
+      nvs_get_i32(_handle, key, &value);
+    return value;
+  }
+  float getFloat(const char* key, float defaultValue = NAN)
+  {
+    float value = defaultValue;
+    getBytes(key, &value, sizeof(value));
+    return value;
+  }
+  double getDouble(const char* key, double defaultValue = NAN)
+  {
+    double value = defaultValue;
+    getBytes(key, &value, sizeof(value));
+    return value;
+  }
+  String getString(const char* key, const String& defaultValue = String())
+  {
+    size_t len = 0;
+    if (!_open || (nvs_get_str(_handle, key, nullptr, &len) != ESP_OK))
+      return defaultValue;
+    std::string value(len, 0);
+    if (nvs_get_str(_handle, key, &value[0], &len) != ESP_OK)
+      return defaultValue;
+    return String(value.c_str());
+  }
+  size_t getBytesLength(const char* key)
+  {
+    size_t len = 0;
+    if (!_open || (nvs_get_blob(_handle, key, nullptr, &len) != ESP_OK))
+      return 0;
+    return len;
+  }
+  //like on the ESP32 nothing is read if the blob does not fit into maxLen
+  size_t getBytes(const char* key, void* buf, size_t maxLen)
+  {
+    size_t len = getBytesLength(key);
+    if ((len == 0) || (len > maxLen) || (nvs_get_blob(_handle, key, buf, &len) != ESP_OK))
+      return 0;
+    return len;
+  }
+  size_t putBytes(const char* key, const void* value, size_t len)
+  {
+    if (!_open || (nvs_set_blob(_handle, key, value, len) != ESP_OK) || (nvs_commit(_handle) != ESP_OK))
+      return 0;
+    return len;
+  }
+  private:
+  nvs_handle_t _handle = 0;
+  bool _open = false;
+};
+
+#endif
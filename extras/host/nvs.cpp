@@ -0,0 +1,223 @@
+/*
+File nvs.cpp
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+Description
+NVS of ESP-IDF emulated in RAM for a Linux host
+*/
+
+#include "nvs.h"
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// a stored key, i32, string or blob
+struct NVSENTRY
+{
+  enum
+  {
+    I32,
+    STR,
+    BLOB
+  } type;
+  int32_t i;
+  std::string bytes;
+};
+
+typedef std::map<std::string, NVSENTRY> NVSSPACE;
+
+// an open handle, closed handles have no space
+struct NVSHANDLE
+{
+  NVSSPACE *space;
+  bool readOnly;
+};
+
+static std::map<std::string, NVSSPACE> spaces;
+static std::vector<NVSHANDLE> handles;
+static int failAt = -1;
+static esp_err_t failErr = ESP_FAIL;
+
+const char *esp_err_to_name(esp_err_t err)
+{
+  switch (err)
+  {
+  case ESP_OK:
+    return "ESP_OK";
+  case ESP_ERR_INVALID_ARG:
+    return "ESP_ERR_INVALID_ARG";
+  case ESP_ERR_NVS_NOT_FOUND:
+    return "ESP_ERR_NVS_NOT_FOUND";
+  case ESP_ERR_NVS_INVALID_HANDLE:
+    return "ESP_ERR_NVS_INVALID_HANDLE";
+  case ESP_ERR_NVS_READ_ONLY:
+    return "ESP_ERR_NVS_READ_ONLY";
+  case ESP_ERR_NVS_NOT_ENOUGH_SPACE:
+    return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+  case ESP_ERR_NVS_INVALID_NAME:
+    return "ESP_ERR_NVS_INVALID_NAME";
+  case ESP_ERR_NVS_INVALID_LENGTH:
+    return "ESP_ERR_NVS_INVALID_LENGTH";
+  default:
+    return "ESP_FAIL";
+  }
+}
+
+// the space of an open handle, nullptr if the handle is not open
+static NVSSPACE *spaceOf(nvs_handle_t handle)
+{
+  if ((handle == 0) || (handle > handles.size()))
+    return nullptr;
+  return handles[handle - 1].space;
+}
+
+// the entry of key with type, nullptr if there is none
+static NVSENTRY *entryOf(nvs_handle_t handle, const char *key, int type)
+{
+  NVSSPACE *space = spaceOf(handle);
+  if (space == nullptr)
+    return nullptr;
+  auto e = space->find(key);
+  return ((e != space->end()) && (e->second.type == type)) ? &e->second : nullptr;
+}
+
+// checks of a write, the injected failure counts the writes
+static esp_err_t checkWrite(nvs_handle_t handle, const char *key)
+{
+  if (spaceOf(handle) == nullptr)
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  if (handles[handle - 1].readOnly)
+    return ESP_ERR_NVS_READ_ONLY;
+  if ((key != nullptr) && ((key[0] == 0) || (strlen(key) >= NVS_KEY_NAME_MAX_SIZE)))
+    return ESP_ERR_NVS_INVALID_NAME;
+  if ((failAt > 0) && (--failAt == 0))
+  {
+    failAt = -1;
+    return failErr;
+  }
+  return ESP_OK;
+}
+
+static esp_err_t setEntry(nvs_handle_t handle, const char *key, const NVSENTRY &entry)
+{
+  esp_err_t err = checkWrite(handle, key);
+  if (err == ESP_OK)
+    (*spaceOf(handle))[key] = entry;
+  return err;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle)
+{
+  if ((name == nullptr) || (name[0] == 0) || (strlen(name) >= NVS_KEY_NAME_MAX_SIZE))
+    return ESP_ERR_NVS_INVALID_NAME;
+  // a namespace is created by the first read-write open
+  if ((mode == NVS_READONLY) && (spaces.find(name) == spaces.end()))
+    return ESP_ERR_NVS_NOT_FOUND;
+  handles.push_back({&spaces[name], mode == NVS_READONLY});
+  *handle = handles.size();
+  return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+  if (spaceOf(handle) != nullptr)
+    handles[handle - 1].space = nullptr;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+  if (spaceOf(handle) == nullptr)
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  if (failAt == 0)
+  {
+    failAt = -1;
+    return failErr;
+  }
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *value)
+{
+  NVSENTRY *e = entryOf(handle, key, NVSENTRY::I32);
+  if (e == nullptr)
+    return ESP_ERR_NVS_NOT_FOUND;
+  *value = e->i;
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *value, size_t *length)
+{
+  NVSENTRY *e = entryOf(handle, key, NVSENTRY::STR);
+  if (e == nullptr)
+    return ESP_ERR_NVS_NOT_FOUND;
+  size_t len = e->bytes.size() + 1;
+  if (value != nullptr)
+  {
+    if (*length < len)
+      return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(value, e->bytes.c_str(), len);
+  }
+  *length = len;
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value, size_t *length)
+{
+  NVSENTRY *e = entryOf(handle, key, NVSENTRY::BLOB);
+  if (e == nullptr)
+    return ESP_ERR_NVS_NOT_FOUND;
+  if (value != nullptr)
+  {
+    if (*length < e->bytes.size())
+      return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(value, e->bytes.data(), e->bytes.size());
+  }
+  *length = e->bytes.size();
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value)
+{
+  return setEntry(handle, key, {NVSENTRY::I32, value, std::string()});
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+  return setEntry(handle, key, {NVSENTRY::STR, 0, std::string(value)});
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+  return setEntry(handle, key, {NVSENTRY::BLOB, 0, std::string((const char *)value, length)});
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+  esp_err_t err = checkWrite(handle, key);
+  if (err != ESP_OK)
+    return err;
+  return (spaceOf(handle)->erase(key) > 0) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+  esp_err_t err = checkWrite(handle, nullptr);
+  if (err == ESP_OK)
+    spaceOf(handle)->clear();
+  return err;
+}
+
+void nvs_host_fail(int n, esp_err_t err)
+{
+  failAt = n;
+  failErr = err;
+}
+
+void nvs_host_reset()
+{
+  spaces.clear();
+  handles.clear();
+  failAt = -1;
+}
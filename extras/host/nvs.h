@@ -0,0 +1,65 @@
+/*
+
+File nvs.h
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+
+Description
+NVS of ESP-IDF emulated in RAM for a Linux host. It provides the
+functions and error codes NVSStorage uses, so the backend can be tested
+with WEBCONFIG_HOST_NVS. Every set or erase writes at once like on the
+ESP32, nvs_commit() only reports the result.
+Writes can be made to fail with nvs_host_fail() to test the rollback.
+
+*/
+#ifndef nvs_h
+#define nvs_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int esp_err_t;
+typedef uint32_t nvs_handle_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_NVS_NOT_FOUND 0x1102
+#define ESP_ERR_NVS_INVALID_HANDLE 0x1107
+#define ESP_ERR_NVS_READ_ONLY 0x1104
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE 0x1105
+#define ESP_ERR_NVS_INVALID_NAME 0x1106
+#define ESP_ERR_NVS_INVALID_LENGTH 0x110c
+
+//maximum length of a key and of a namespace
+#define NVS_KEY_NAME_MAX_SIZE 16
+
+typedef enum {
+  NVS_READONLY,
+  NVS_READWRITE
+} nvs_open_mode_t;
+
+const char* esp_err_to_name(esp_err_t err);
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t mode, nvs_handle_t* handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* value);
+//with value nullptr only the length including the terminating zero is returned
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* value, size_t* length);
+//with value nullptr only the length is returned
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* value, size_t* length);
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value);
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key);
+esp_err_t nvs_erase_all(nvs_handle_t handle);
+
+//host only: the write number n (set or erase, counted from 1) fails with
+//err, with n = 0 the next commit fails. n < 0 turns the failure off
+void nvs_host_fail(int n, esp_err_t err);
+//host only: erase all namespaces
+void nvs_host_reset();
+
+#endif
@@ -0,0 +1,401 @@
+/*
+File loadtest.cpp
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+Description
+HTTP load generator for WebConfig on a Linux host. The form is served by
+a single threaded server on a POSIX socket, like WebServer serves it from
+loop(). Client threads send GET requests for the form and POST requests
+saving all fields at a given rate and report throughput, latency and the
+allocations of the server per request.
+The String of the host is a std::string which holds up to 15 characters
+without an allocation, the String of the ESP cores up to 11. Strings of
+12 to 15 characters are not counted, so the allocations are a lower
+bound of those on the device.
+Usage:
+  wcloadtest [-c clients] [-n requests] [-r rate] [-f fields] [-p post%] [-s slice]
+  -c number of client threads (4)
+  -n requests per client (500)
+  -r requests per second per client, 0 = as fast as possible (0)
+  -f number of fields of the generated schema, max MAXVALUES (20)
+  -p percentage of POST requests (20)
+  -s chunk size of the responses (CHUNKSIZE)
+*/
+
+#include <Arduino.h>
+#include <WebConfig.h>
+#include <WebConfigTransport.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <new>
+
+// allocations of the server while it handles a request, short strings
+// held inside the String object are not counted
+static std::atomic<unsigned long> allocations(0);
+static thread_local boolean counting = false;
+
+void *operator new(size_t size)
+{
+  if (counting)
+    allocations++;
+  void *p = malloc(size ? size : 1);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+// request received from a socket, the response is written to the socket
+// the arguments are parsed and held by the local transport
+class SocketTransport : public WebConfigLocalTransport {
+  public:
+  SocketTransport(int fd) : _fd(fd) {}
+  // read the request line, the headers and an urlencoded body
+  boolean readRequest();
+  boolean isPost() override { return _post; }
+  void sendHeader(const char *name, const char *value) override;
+  void send(int code, const char *contentType, WebConfigFiller filler) override;
+  private:
+  int _fd;
+  boolean _post = false;
+  String _headers;
+  boolean writeAll(const char *data, size_t len);
+};
+
+boolean SocketTransport::readRequest()
+{
+  char buf[1024];
+  String request;
+  int end = -1;
+  while (end < 0)
+  {
+    ssize_t n = recv(_fd, buf, sizeof(buf), 0);
+    if (n <= 0)
+      return false;
+    request.concat(buf, n);
+    end = request.indexOf("\r\n\r\n");
+  }
+  _post = request.startsWith("POST ");
+  int start = request.indexOf(' ') + 1;
+  int stop = request.indexOf(' ', start);
+  String uri = request.substring(start, stop);
+  int query = uri.indexOf('?');
+  if (query >= 0)
+    parseArgs(uri.c_str() + query + 1);
+  if (_post)
+  {
+    int pos = request.indexOf("Content-Length:");
+    size_t len = (pos >= 0) ? atol(request.c_str() + pos + 15) : 0;
+    String body = request.substring(end + 4);
+    while (body.length() < len)
+    {
+      ssize_t n = recv(_fd, buf, sizeof(buf), 0);
+      if (n <= 0)
+        return false;
+      body.concat(buf, n);
+    }
+    parseArgs(body.c_str());
+  }
+  return true;
+}
+
+boolean SocketTransport::writeAll(const char *data, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t n = ::send(_fd, data, len, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+void SocketTransport::sendHeader(const char *name, const char *value)
+{
+  _headers += name;
+  _headers += ": ";
+  _headers += value;
+  _headers += "\r\n";
+}
+
+// the body is written as it is pulled, the end is the closed connection
+void SocketTransport::send(int code, const char *contentType, WebConfigFiller filler)
+{
+  char head[128];
+  uint8_t buf[CHUNKSIZE];
+  size_t size = (chunkSize < sizeof(buf)) ? chunkSize : sizeof(buf);
+  size_t n;
+  snprintf(head, sizeof(head), "HTTP/1.1 %d OK\r\nContent-Type: %s\r\nConnection: close\r\n", code, contentType);
+  boolean ok = writeAll(head, strlen(head)) && writeAll(_headers.c_str(), _headers.length()) && writeAll("\r\n", 2);
+  while (ok && ((n = filler(buf, size)) > 0))
+    ok = writeAll((const char *)buf, n);
+  this->code = code;
+}
+
+// schema with fields of all simple types
+static String createSchema(uint8_t fields)
+{
+  static const char *types[] = {"text", "number", "check", "select", "range", "float", "password"};
+  String schema = "[";
+  char buf[200];
+  for (uint8_t i = 0; i < fields; i++)
+  {
+    const char *type = types[i % 7];
+    snprintf(buf, sizeof(buf), "%s{\"name\":\"field%u\",\"label\":\"Field %u\",\"type\":\"%s\",\"min\":0,\"max\":100,\"default\":\"%s\"",
+             (i > 0) ? "," : "", i, i, type, (strcmp(type, "select") == 0) ? "b" : "1");
+    schema += buf;
+    if (strcmp(type, "select") == 0)
+      schema += ",\"options\":[{\"v\":\"a\",\"l\":\"A\"},{\"v\":\"b\",\"l\":\"B\"},{\"v\":\"c\",\"l\":\"C\"}]";
+    schema += "}";
+  }
+  schema += "]";
+  return schema;
+}
+
+// urlencoded form with a valid value for every field
+static String createForm(uint8_t fields, unsigned long seq)
+{
+  String form = "SAVE=1";
+  char buf[64];
+  for (uint8_t i = 0; i < fields; i++)
+  {
+    switch (i % 7)
+    {
+    case 2:
+      if (seq & 1)
+      {
+        snprintf(buf, sizeof(buf), "&field%u=on", i);
+        form += buf;
+      }
+      continue;
+    case 3:
+      snprintf(buf, sizeof(buf), "&field%u=%c", i, 'a' + (char)(seq % 3));
+      break;
+    case 5:
+      snprintf(buf, sizeof(buf), "&field%u=%lu.5", i, seq % 100);
+      break;
+    default:
+      snprintf(buf, sizeof(buf), "&field%u=%lu", i, seq % 100);
+      break;
+    }
+    form += buf;
+  }
+  return form;
+}
+
+// latencies in microseconds of one request type
+struct RESULTS {
+  std::vector<unsigned long> latency;
+  unsigned long errors = 0;
+};
+
+static std::atomic<unsigned long> getAllocations(0);
+static std::atomic<unsigned long> postAllocations(0);
+static std::atomic<boolean> running(true);
+
+// accept and handle one connection after the other like WebServer
+static void serve(WebConfig *conf, int listener, size_t chunkSize)
+{
+  while (running)
+  {
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0)
+      continue;
+    counting = true;
+    unsigned long before = allocations;
+    {
+      SocketTransport transport(fd);
+      transport.chunkSize = chunkSize;
+      if (transport.readRequest())
+      {
+        boolean post = transport.isPost();
+        conf->handleFormRequest(&transport);
+        // the connection waking the server at the end is not counted
+        if (running)
+          (post ? postAllocations : getAllocations) += allocations - before;
+      }
+    }
+    counting = false;
+    close(fd);
+  }
+}
+
+// one HTTP request, returns the latency in microseconds, 0 on error
+static unsigned long request(uint16_t port, const String &req)
+{
+  char buf[2048];
+  auto start = std::chrono::steady_clock::now();
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  boolean ok = connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0;
+  ok = ok && (::send(fd, req.c_str(), req.length(), MSG_NOSIGNAL) == (ssize_t)req.length());
+  ssize_t n;
+  size_t total = 0;
+  while (ok && ((n = recv(fd, buf, sizeof(buf), 0)) > 0))
+  {
+    // only the status of the first packet is checked
+    if (total == 0)
+      ok = strncmp(buf, "HTTP/1.1 200", 12) == 0;
+    total += n;
+  }
+  close(fd);
+  if (!ok || (total == 0))
+    return 0;
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  return (us > 0) ? us : 1;
+}
+
+static void client(uint16_t port, unsigned long requests, unsigned long rate, uint8_t fields, uint8_t postPercent,
+                   unsigned int id, RESULTS *get, RESULTS *post)
+{
+  auto next = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < requests; i++)
+  {
+    boolean isPost = ((i * 100 + id * 37) % 100) < postPercent;
+    String req;
+    if (isPost)
+    {
+      String form = createForm(fields, i + id);
+      req = "POST / HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: ";
+      req += String((unsigned long)form.length());
+      req += "\r\n\r\n";
+      req += form;
+    }
+    else
+    {
+      req = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    }
+    unsigned long us = request(port, req);
+    RESULTS *r = isPost ? post : get;
+    if (us == 0)
+      r->errors++;
+    else
+      r->latency.push_back(us);
+    if (rate > 0)
+    {
+      next += std::chrono::microseconds(1000000UL / rate);
+      std::this_thread::sleep_until(next);
+    }
+  }
+}
+
+static void report(const char *name, std::vector<RESULTS> &results, unsigned long allocs)
+{
+  std::vector<unsigned long> all;
+  unsigned long errors = 0;
+  for (RESULTS &r : results)
+  {
+    all.insert(all.end(), r.latency.begin(), r.latency.end());
+    errors += r.errors;
+  }
+  if (all.empty())
+  {
+    printf("%-5s no requests, %lu errors\n", name, errors);
+    return;
+  }
+  std::sort(all.begin(), all.end());
+  printf("%-5s %7zu requests %5lu errors  p50 %8.3f ms  p99 %8.3f ms  %6.1f allocations/request\n", name, all.size(), errors,
+         all[all.size() / 2] / 1000.0, all[(all.size() * 99) / 100] / 1000.0, (double)allocs / all.size());
+}
+
+int main(int argc, char **argv)
+{
+  unsigned int clients = 4;
+  unsigned long requests = 500;
+  unsigned long rate = 0;
+  unsigned int fields = MAXVALUES;
+  unsigned int postPercent = 20;
+  size_t chunkSize = CHUNKSIZE;
+  for (int a = 1; a + 1 < argc; a += 2)
+  {
+    unsigned long v = strtoul(argv[a + 1], nullptr, 10);
+    switch ((argv[a][0] == '-') ? argv[a][1] : 0)
+    {
+    case 'c':
+      clients = v;
+      break;
+    case 'n':
+      requests = v;
+      break;
+    case 'r':
+      rate = v;
+      break;
+    case 'f':
+      fields = (v < MAXVALUES) ? v : MAXVALUES;
+      break;
+    case 'p':
+      postPercent = (v < 100) ? v : 100;
+      break;
+    case 's':
+      chunkSize = (v > 0) ? v : CHUNKSIZE;
+      break;
+    default:
+      fprintf(stderr, "usage: wcloadtest [-c clients] [-n requests] [-r rate] [-f fields] [-p post%%] [-s slice]\n");
+      return 2;
+    }
+  }
+  RAMStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(createSchema(fields));
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if ((bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0) || (listen(listener, 128) != 0) ||
+      (getsockname(listener, (sockaddr *)&addr, &len) != 0))
+  {
+    perror("listen");
+    return 1;
+  }
+  uint16_t port = ntohs(addr.sin_port);
+  std::thread server(serve, &conf, listener, chunkSize);
+
+  printf("%u fields, %u clients, %lu requests per client, %u%% POST, rate %lu/s per client\n",
+         conf.getCount(), clients, requests, postPercent, rate);
+  std::vector<RESULTS> get(clients);
+  std::vector<RESULTS> post(clients);
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < clients; i++)
+    threads.emplace_back(client, port, requests, rate, fields, postPercent, i, &get[i], &post[i]);
+  for (std::thread &t : threads)
+    t.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // wake the server with a last connection
+  running = false;
+  request(port, "GET / HTTP/1.1\r\n\r\n");
+  server.join();
+  close(listener);
+
+  printf("%.0f requests/s in %.2f s\n", clients * requests / seconds, seconds);
+  report("GET", get, getAllocations);
+  report("POST", post, postAllocations);
+  return 0;
+}
@@ -0,0 +1,168 @@
+/*
+File provision.cpp
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+Description
+Host tool to preconfigure many devices offline. It reads the JSON schema
+of the sketch and one values file per device and writes for every device
+the config file for LittleFS or a CSV for the NVS partition generator.
+The values files use the backup format of WebConfig (?wc=export):
+  #WCB1 0
+  deviceName=sensor-17
+  ssid=factory
+  #END
+The device name defaults to the name of the values file. The library
+itself parses the schema, validates the values and writes the files, so
+the formats are the same as on the device.
+Usage:
+  wcprovision [-n namespace] [-o outdir] schema.json device.wcb ...
+Without -n the config file is written to outdir/<device>/WebConf.conf,
+pack the directory with mklittlefs. With -n the CSV outdir/<device>.csv
+is written, create the image with nvs_partition_gen.py
+*/
+
+#include <Arduino.h>
+#include <WebConfig.h>
+#include <WebConfigStorage.h>
+#include <sys/stat.h>
+
+// storage of the schema between the devices with the name limit of the
+// target backend, so names are trimmed like on the device
+class SchemaStorage : public RAMStorage {
+  public:
+  SchemaStorage(uint8_t maxName) : _maxName(maxName) {}
+  uint8_t maxNameLength() override { return _maxName; }
+  private:
+  uint8_t _maxName;
+};
+
+// read a whole file, returns false if it cannot be read
+static boolean readFile(const char *path, String &content)
+{
+  char buf[256];
+  size_t n;
+  FILE *f = fopen(path, "r");
+  if (f == nullptr)
+    return false;
+  content = "";
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    content.concat(buf, n);
+  fclose(f);
+  return true;
+}
+
+// name of the device, the file name without directory and extension
+static String deviceId(const char *path)
+{
+  String id = path;
+  int pos = id.lastIndexOf('/');
+  if (pos >= 0)
+    id = id.substring(pos + 1);
+  pos = id.lastIndexOf('.');
+  if (pos > 0)
+    id = id.substring(0, pos);
+  return id;
+}
+
+// pass the values file to the restore decoder of the library
+static boolean importFile(WebConfig &conf, const char *path, const String &id)
+{
+  String content;
+  if (!readFile(path, content) || !content.startsWith("#WCB1 "))
+    return false;
+  // the default name follows the header, a deviceName line in the file
+  // replaces it
+  int pos = content.indexOf('\n') + 1;
+  String name = "deviceName=" + id + "\n";
+  WebConfigImportState *state = conf.beginImport();
+  boolean ok = conf.importChunk(state, (const uint8_t *)content.c_str(), pos) &&
+               conf.importChunk(state, (const uint8_t *)name.c_str(), name.length()) &&
+               conf.importChunk(state, (const uint8_t *)content.c_str() + pos, content.length() - pos);
+  return conf.endImport(state) && ok;
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: wcprovision [-n namespace] [-o outdir] schema.json device.wcb ...\n");
+}
+
+int main(int argc, char **argv)
+{
+  const char *nameSpace = nullptr;
+  String outDir = ".";
+  int a = 1;
+  for (; (a < argc) && (argv[a][0] == '-'); a++)
+  {
+    if ((strcmp(argv[a], "-n") == 0) && (a + 1 < argc))
+      nameSpace = argv[++a];
+    else if ((strcmp(argv[a], "-o") == 0) && (a + 1 < argc))
+      outDir = argv[++a];
+    else
+    {
+      usage();
+      return 2;
+    }
+  }
+  if (argc - a < 2)
+  {
+    usage();
+    return 2;
+  }
+  String schema;
+  if (!readFile(argv[a], schema))
+  {
+    fprintf(stderr, "cannot read %s\n", argv[a]);
+    return 1;
+  }
+  mkdir(outDir.c_str(), 0755);
+  // one instance for all devices, only the storage is replaced. The
+  // schema is parsed with the name limit of the backend written to
+  uint8_t maxName = (nameSpace != nullptr) ? NVSCsvStorage("", nameSpace).maxNameLength()
+                                           : PosixStorage("").maxNameLength();
+  SchemaStorage ram(maxName);
+  WebConfig conf(&ram);
+  conf.addDescription(schema);
+  if (conf.getCount() == 0)
+  {
+    fprintf(stderr, "no fields in %s\n", argv[a]);
+    return 1;
+  }
+  int failed = 0;
+  for (a++; a < argc; a++)
+  {
+    String id = deviceId(argv[a]);
+    String path;
+    WebConfigStorage *storage;
+    if (nameSpace != nullptr)
+    {
+      path = outDir + "/" + id + ".csv";
+      storage = new NVSCsvStorage(path.c_str(), nameSpace);
+    }
+    else
+    {
+      path = outDir + "/" + id;
+      mkdir(path.c_str(), 0755);
+      path += CONFFILE;
+      storage = new PosixStorage(path.c_str());
+    }
+    // the values of every device start from the defaults, nothing is
+    // written before the restore commits
+    conf.setStorage(storage);
+    for (uint8_t i = 0; i < conf.getCount(); i++)
+      conf.resetValue(conf.getName(i).c_str());
+    // the restore commits only if values changed, flush writes every device
+    if (importFile(conf, argv[a], id) && conf.flush())
+    {
+      printf("%s\n", path.c_str());
+    }
+    else
+    {
+      fprintf(stderr, "%s: rejected\n", argv[a]);
+      failed++;
+    }
+    conf.setStorage(&ram);
+    delete storage;
+  }
+  return (failed > 0) ? 1 : 0;
+}
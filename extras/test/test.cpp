@@ -0,0 +1,1337 @@
+/*
+File test.cpp
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+Description
+Host tests of WebConfig. Every test uses its own instance with a storage
+in RAM. Failed checks are printed with their line, the exit code is 1 if
+a check failed.
+Usage:
+  wctest [test]
+  without argument all tests are run
+*/
+
+#include <Arduino.h>
+#include <WebConfig.h>
+#include <WebConfigTransport.h>
+#include <WebConfigNumber.h>
+#include <nvs.h>
+#include <unistd.h>
+#include <vector>
+
+static unsigned int checks = 0;
+static unsigned int failures = 0;
+
+static void check(boolean ok, const char *text, int line)
+{
+  checks++;
+  if (ok)
+    return;
+  failures++;
+  printf("  line %d: %s failed\n", line, text);
+}
+
+static void checkString(const char *actual, const char *expected, const char *text, int line)
+{
+  checks++;
+  if ((actual != nullptr) && (strcmp(actual, expected) == 0))
+    return;
+  failures++;
+  printf("  line %d: %s is \"%s\", expected \"%s\"\n", line, text, actual ? actual : "(null)", expected);
+}
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+#define CHECK_STRING(actual, expected) checkString((actual), (expected), #actual, __LINE__)
+
+// storage in RAM which counts the stores and can be made to fail
+class TestStorage : public RAMStorage {
+  public:
+  boolean store(const CONFIGENTRY *entries, uint8_t count) override
+  {
+    stores++;
+    return !fail && RAMStorage::store(entries, count);
+  }
+  unsigned int stores = 0;
+  boolean fail = false;
+};
+
+// bytes written by Print and read back as Stream
+class ByteStream : public Stream {
+  public:
+  ByteStream() {}
+  ByteStream(const uint8_t *data, size_t len) : bytes((const char *)data, len) {}
+  size_t write(uint8_t c) override
+  {
+    bytes += (char)c;
+    return 1;
+  }
+  int available() override { return bytes.size() - pos; }
+  int read() override { return (pos < bytes.size()) ? (uint8_t)bytes[pos++] : -1; }
+  int peek() override { return (pos < bytes.size()) ? (uint8_t)bytes[pos] : -1; }
+  boolean equals(const uint8_t *data, size_t len) { return (bytes.size() == len) && (memcmp(bytes.data(), data, len) == 0); }
+  std::string bytes;
+  size_t pos = 0;
+};
+
+//*************************** form body **************************************
+static const char *FORMSCHEMA = "[{\"name\":\"text\",\"default\":\"x\",\"maxlen\":8},"
+                                "{\"name\":\"num\",\"type\":\"number\",\"min\":-5,\"max\":100,\"default\":\"1\"},"
+                                "{\"name\":\"chk\",\"type\":\"check\",\"default\":\"1\"},"
+                                "{\"name\":\"multi\",\"type\":\"multicheck\",\"default\":\"000\","
+                                "\"options\":[{\"v\":\"a\"},{\"v\":\"b\"},{\"v\":\"c\"}]},"
+                                "{\"name\":\"sel\",\"type\":\"select\",\"default\":\"a\","
+                                "\"options\":[{\"v\":\"a\"},{\"v\":\"b\"}]}]";
+
+// the body decodes to the same values wherever it is split
+static void testFormSplit()
+{
+  const char *body = "text=h%20i+x&num=150&multi=0&multi=2&sel=b&unknown=1&SAVE=";
+  size_t len = strlen(body);
+  for (size_t split = 0; split <= len; split++)
+  {
+    TestStorage storage;
+    WebConfig conf(&storage);
+    conf.addDescription(FORMSCHEMA);
+    WebConfigFormState *form = conf.beginForm();
+    conf.formChunk(form, (const uint8_t *)body, split);
+    conf.formChunk(form, (const uint8_t *)body + split, len - split);
+    CHECK(conf.endForm(form) == 0);
+    CHECK_STRING(conf.getValue("text"), "h i x");
+    // numbers are clamped, a checkbox not sent is cleared
+    CHECK_STRING(conf.getValue("num"), "100");
+    CHECK_STRING(conf.getValue("chk"), "0");
+    CHECK_STRING(conf.getValue("multi"), "101");
+    CHECK_STRING(conf.getValue("sel"), "b");
+  }
+}
+
+// a body fed byte by byte
+static void testFormBytes()
+{
+  const char *body = "chk=on&num=-3&text=%41%42";
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  WebConfigFormState *form = conf.beginForm();
+  for (const char *p = body; *p != 0; p++)
+    conf.formChunk(form, (const uint8_t *)p, 1);
+  CHECK(conf.endForm(form) == 0);
+  CHECK_STRING(conf.getValue("chk"), "1");
+  CHECK_STRING(conf.getValue("num"), "-3");
+  CHECK_STRING(conf.getValue("text"), "AB");
+}
+
+// rejected values keep the old value and are counted
+static void testFormInvalid()
+{
+  const char *body = "num=12abc&text=toolongvalue&sel=z&multi=7";
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  WebConfigFormState *form = conf.beginForm();
+  conf.formChunk(form, (const uint8_t *)body, strlen(body));
+  CHECK(conf.endForm(form) == 4);
+  CHECK_STRING(conf.getValue("num"), "1");
+  CHECK_STRING(conf.getValue("text"), "x");
+  CHECK_STRING(conf.getValue("sel"), "a");
+  CHECK_STRING(conf.getValue("multi"), "000");
+}
+
+// the bodies of two requests are decoded at the same time
+static void testFormConcurrent()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  WebConfigFormState *a = conf.beginForm();
+  WebConfigFormState *b = conf.beginForm();
+  conf.formChunk(a, (const uint8_t *)"text=he", 7);
+  conf.formChunk(b, (const uint8_t *)"num=4", 5);
+  conf.formChunk(a, (const uint8_t *)"llo&chk=1", 9);
+  conf.formChunk(b, (const uint8_t *)"2", 1);
+  CHECK(conf.endForm(b) == 0);
+  CHECK(conf.endForm(a) == 0);
+  CHECK_STRING(conf.getValue("text"), "hello");
+  CHECK_STRING(conf.getValue("num"), "42");
+  WebConfig::discardForm(conf.beginForm());
+}
+
+// a submit of the form is decoded from the body and saved once
+static void testFormRequest()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  WebConfigLocalTransport request;
+  request.post = true;
+  request.addArg("wc", "submit");
+  request.addArg("plain", "text=saved&num=7&SAVE=");
+  conf.handleFormRequest(&request);
+  CHECK(request.code == 200);
+  CHECK(storage.stores == 1);
+  CHECK_STRING(conf.getValue("text"), "saved");
+  CHECK_STRING(conf.getValue("num"), "7");
+}
+
+//*************************** observers **************************************
+// the changed fields are reported once per save, observers per field
+static void testObservers()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  int saves = 0;
+  WebConfigChanges saved;
+  std::string seen;
+  conf.registerOnSaveChanges([&](const WebConfigChanges &c)
+                             { saves++; saved = c; });
+  CHECK(!conf.registerOnChange("nosuch", [](const char *name, const String &value) {}));
+  CHECK(conf.registerOnChange("text", [&](const char *name, const String &value)
+                              { seen += std::string(name) + "=" + value.c_str() + ";"; }));
+  CHECK(conf.registerOnChange("chk", [&](const char *name, const String &value)
+                              { seen += std::string(name) + "=" + value.c_str() + ";"; }));
+  conf.setValues("{\"text\":\"a\",\"num\":5}");
+  CHECK(saves == 1);
+  CHECK(saved.contains(0) && saved.contains(1) && !saved.contains(2));
+  CHECK(saved.count() == 2);
+  CHECK(seen == "text=a;");
+  CHECK(!conf.getChanges().any());
+  // an unchanged value is no change
+  conf.setValues("{\"text\":\"a\"}");
+  CHECK(saves == 1);
+  // single changes are collected until the next save event
+  conf.setValue("num", "6");
+  CHECK(conf.getChanges().contains(1));
+  CHECK(saves == 1);
+  seen = "";
+  WebConfigLocalTransport request;
+  request.post = true;
+  request.addArg("wc", "submit");
+  request.addArg("plain", "text=a&SAVE=");
+  conf.handleFormRequest(&request);
+  CHECK(request.code == 200);
+  CHECK(saves == 2);
+  CHECK(saved.contains(1) && saved.contains(2) && !saved.contains(0));
+  CHECK(seen == "chk=0;");
+  CHECK(!conf.getChanges().any());
+}
+
+//*************************** transport **************************************
+// arguments are decoded, the body is passed and pulled in chunks
+static void testTransport()
+{
+  WebConfigLocalTransport t;
+  t.parseArgs("a=1&b=h%20i+x&flag&c=%4");
+  CHECK(t.args() == 4);
+  CHECK_STRING(t.argName(1).c_str(), "b");
+  CHECK_STRING(t.arg("b").c_str(), "h i x");
+  CHECK(t.hasArg("flag"));
+  CHECK_STRING(t.arg("flag").c_str(), "");
+  // an incomplete escape is kept as it is
+  CHECK_STRING(t.arg("c").c_str(), "%4");
+  CHECK(!t.hasArg("d"));
+  CHECK_STRING(t.arg("d").c_str(), "");
+  CHECK_STRING(t.arg(9).c_str(), "");
+  // without the argument plain there is no body
+  CHECK(!t.readBody([](const uint8_t *data, size_t len) {}));
+  t.addArg("plain", "x=1");
+  std::string body;
+  CHECK(t.readBody([&](const uint8_t *data, size_t len)
+                   { body.append((const char *)data, len); }));
+  CHECK(body == "x=1");
+  t.clear();
+  CHECK(t.args() == 0);
+  for (int i = 0; i < LOCAL_MAXARGS; i++)
+    CHECK(t.addArg("n", "v"));
+  CHECK(!t.addArg("n", "v"));
+
+  // the response is pulled in chunks of at most chunkSize bytes
+  t.clear();
+  t.chunkSize = 10;
+  size_t left = 25;
+  size_t largest = 0;
+  t.sendHeader("X-Test", "1");
+  t.send(201, "text/plain", [&](uint8_t *buffer, size_t maxLen)
+         {
+           size_t n = std::min(left, maxLen);
+           largest = std::max(largest, maxLen);
+           memset(buffer, 'a', n);
+           left -= n;
+           return n; });
+  CHECK(t.code == 201);
+  CHECK_STRING(t.contentType.c_str(), "text/plain");
+  CHECK_STRING(t.headers.c_str(), "X-Test: 1\n");
+  CHECK(t.body.length() == 25);
+  CHECK(t.chunks == 3);
+  CHECK(largest == 10);
+  // a chunk size above the buffer is limited to it
+  t.chunkSize = 10000;
+  left = 1000;
+  largest = 0;
+  t.send(200, "text/plain", [&](uint8_t *buffer, size_t maxLen)
+         {
+           size_t n = std::min(left, maxLen);
+           largest = std::max(largest, maxLen);
+           memset(buffer, 'b', n);
+           left -= n;
+           return n; });
+  CHECK(t.body.length() == 1000);
+  CHECK(largest == CHUNKSIZE);
+}
+
+//*************************** storage ****************************************
+// the entries and blobs written are read back by the same backend
+static void checkBackend(WebConfigStorage &storage)
+{
+  std::string loaded;
+  auto loader = [&](const char *name, const char *value)
+  { loaded += std::string(name) + "=" + value + ";"; };
+  CHECK(!storage.load(nullptr, 0, loader));
+  CONFIGENTRY entries[] = {{"text", "a=b\nc", STORE_STRING},
+                           {"num", "-12", STORE_INT},
+                           {"gone", nullptr, STORE_STRING},
+                           {"empty", "", STORE_STRING}};
+  CHECK(storage.store(entries, 4));
+  CHECK(storage.load(entries, 4, loader));
+  CHECK(loaded == "text=a=b\nc;num=-12;empty=;");
+  // a second store replaces the complete config
+  entries[0].value = nullptr;
+  CHECK(storage.store(entries, 2));
+  loaded = "";
+  CHECK(storage.load(entries, 2, loader));
+  CHECK(loaded == "num=-12;");
+
+  uint8_t blob[300];
+  uint8_t back[300];
+  for (size_t i = 0; i < sizeof(blob); i++)
+    blob[i] = i * 7;
+  CHECK(storage.blobSize("b1") == 0);
+  CHECK(storage.storeBlob("b1", blob, sizeof(blob)));
+  CHECK(storage.storeBlob("b2", blob, 10));
+  CHECK(storage.blobSize("b1") == sizeof(blob));
+  CHECK(storage.loadBlob("b1", back, sizeof(back)));
+  CHECK(memcmp(blob, back, sizeof(blob)) == 0);
+  // a blob written again gets the new size
+  CHECK(storage.storeBlob("b1", blob + 1, 5));
+  CHECK(storage.blobSize("b1") == 5);
+  CHECK(storage.loadBlob("b1", back, 5));
+  CHECK(memcmp(blob + 1, back, 5) == 0);
+  CHECK(storage.removeBlob("b1"));
+  CHECK(storage.blobSize("b1") == 0);
+  CHECK(storage.blobSize("b2") == 10);
+  // a blob which does not exist counts as deleted
+  CHECK(storage.removeBlob("b1"));
+  CHECK(storage.removeBlob("b2"));
+
+  CHECK(storage.remove());
+  CHECK(!storage.load(entries, 2, loader));
+}
+
+static void testRAMStorage()
+{
+  RAMStorage storage;
+  checkBackend(storage);
+}
+
+// files in a temporary directory, the config is also read by a new instance
+static void testPosixStorage()
+{
+  char dir[] = "/tmp/wctestXXXXXX";
+  CHECK(mkdtemp(dir) != nullptr);
+  String path = String(dir) + "/WebConf.conf";
+  PosixStorage storage(path.c_str());
+  checkBackend(storage);
+  {
+    WebConfig conf(&storage);
+    conf.addDescription(FORMSCHEMA);
+    conf.setValues("{\"text\":\"on\\ndisk\",\"num\":42}");
+    CHECK(conf.writeConfig());
+  }
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  CHECK(conf.readConfig());
+  CHECK_STRING(conf.getValue("text"), "on\ndisk");
+  CHECK_STRING(conf.getValue("num"), "42");
+  CHECK(storage.remove());
+  storage.removeBlob("wcschema");
+  CHECK(rmdir(dir) == 0);
+}
+
+//*************************** NVS ********************************************
+// the backend on the NVS emulation of the host
+static void testNVSStorage()
+{
+  nvs_host_reset();
+  NVSStorage storage("wctest");
+  checkBackend(storage);
+}
+
+// values of the entries as loaded
+static std::string loadNVS(NVSStorage &storage, const CONFIGENTRY *entries, uint8_t count)
+{
+  std::string loaded;
+  storage.load(entries, count, [&](const char *name, const char *value)
+               { loaded += std::string(name) + "=" + value + ";"; });
+  return loaded;
+}
+
+// only changed keys are written, a failed write or commit restores the
+// keys written before
+static void testNVSRollback()
+{
+  nvs_host_reset();
+  NVSStorage storage("wctest");
+  CONFIGENTRY entries[] = {{"text", "a", STORE_STRING},
+                           {"num", "5", STORE_INT},
+                           {"f", "1.5", STORE_FLOAT},
+                           {"gone", "x", STORE_STRING}};
+  CHECK(storage.store(entries, 4));
+  CHECK(storage.getWriteCount() == 4);
+  const std::string stored = "text=a;num=5;f=1.5;gone=x;";
+  CHECK(loadNVS(storage, entries, 4) == stored);
+  CHECK(storage.store(entries, 4));
+  CHECK(storage.getWriteCount() == 0);
+
+  CONFIGENTRY changed[] = {{"text", "b", STORE_STRING},
+                           {"num", "6", STORE_INT},
+                           {"f", "2.5", STORE_FLOAT},
+                           {"gone", nullptr, STORE_STRING}};
+  // every write may fail, the erase of gone as well
+  for (int n = 1; n <= 4; n++)
+  {
+    nvs_host_fail(n, ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    CHECK(!storage.store(changed, 4));
+    CHECK(loadNVS(storage, entries, 4) == stored);
+  }
+  nvs_host_fail(0, ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+  CHECK(!storage.store(changed, 4));
+  CHECK(loadNVS(storage, entries, 4) == stored);
+  // a number which does not fit into an i32 fails the store
+  changed[1].value = "99999999999";
+  CHECK(!storage.store(changed, 4));
+  CHECK(loadNVS(storage, entries, 4) == stored);
+  changed[1].value = "6";
+  CHECK(storage.store(changed, 4));
+  CHECK(storage.getWriteCount() == 4);
+  CHECK(loadNVS(storage, entries, 4) == "text=b;num=6;f=2.5;");
+
+  // a failed save of WebConfig keeps the stored values
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  conf.setValue("text", "c");
+  conf.setValue("num", "7");
+  nvs_host_fail(2, ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+  CHECK(!conf.writeConfig());
+  CHECK(loadNVS(storage, entries, 2) == "text=b;num=6;");
+  CHECK(conf.writeConfig());
+  CHECK(loadNVS(storage, entries, 2) == "text=c;num=7;");
+}
+
+//*************************** backup and restore *****************************
+static const char *RESTORESCHEMA = "[{\"name\":\"text\",\"default\":\"x\",\"maxlen\":12},"
+                                   "{\"name\":\"num\",\"type\":\"number\",\"min\":0,\"max\":50,\"default\":\"1\"}]";
+
+// the complete backup read in pieces of chunk bytes
+static String exportBlob(WebConfig &conf, boolean withHash, size_t chunk)
+{
+  uint8_t buf[64];
+  String blob;
+  size_t n;
+  conf.beginExport(withHash);
+  while ((n = conf.exportChunk(buf, chunk)) > 0)
+    blob.concat((const char *)buf, n);
+  return blob;
+}
+
+static boolean importBlob(WebConfig &conf, const String &blob)
+{
+  WebConfigImportState *state = conf.beginImport();
+  conf.importChunk(state, (const uint8_t *)blob.c_str(), blob.length());
+  return conf.endImport(state);
+}
+
+// escaped values survive a backup read and restored in small pieces
+static void testRestoreRoundTrip()
+{
+  TestStorage source;
+  WebConfig from(&source);
+  from.addDescription(RESTORESCHEMA);
+  from.setValue("text", "a%b\nc=d");
+  from.setValue("num", "42");
+  String blob = exportBlob(from, true, 5);
+  CHECK(blob.startsWith("#WCB1 "));
+  CHECK(blob.endsWith("#END\n"));
+  for (size_t split = 0; split <= blob.length(); split++)
+  {
+    TestStorage storage;
+    WebConfig conf(&storage);
+    conf.addDescription(RESTORESCHEMA);
+    WebConfigImportState *state = conf.beginImport();
+    CHECK(conf.importChunk(state, (const uint8_t *)blob.c_str(), split));
+    CHECK(conf.importChunk(state, (const uint8_t *)blob.c_str() + split, blob.length() - split));
+    CHECK(conf.endImport(state));
+    CHECK_STRING(conf.getValue("text"), "a%b\nc=d");
+    CHECK_STRING(conf.getValue("num"), "42");
+    CHECK_STRING(conf.getDeviceName(), from.getDeviceName());
+    CHECK(storage.stores == 1);
+  }
+}
+
+// a rejected restore changes nothing
+static void testRestoreRejected()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(RESTORESCHEMA);
+  conf.setValue("text", "old");
+  uint32_t version = conf.getVersion();
+  // incomplete, invalid value, other schema
+  CHECK(!importBlob(conf, "#WCB1 0\ntext=new\n"));
+  CHECK(!importBlob(conf, "#WCB1 0\ntext=new\nnum=abc\n#END\n"));
+  CHECK(!importBlob(conf, "#WCB1 12345678\ntext=new\n#END\n"));
+  // no header, broken escape
+  CHECK(!importBlob(conf, "text=new\n#END\n"));
+  CHECK(!importBlob(conf, "#WCB1 0\ntext=n%4\n#END\n"));
+  CHECK_STRING(conf.getValue("text"), "old");
+  CHECK(conf.getVersion() == version);
+  // a number out of range is clamped like in the form
+  CHECK(importBlob(conf, "#WCB1 0\nnum=99\n#END\n"));
+  CHECK_STRING(conf.getValue("num"), "50");
+}
+
+// values longer than maxlen are not buffered
+static void testRestoreLength()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(RESTORESCHEMA);
+  WebConfigImportState *state = conf.beginImport();
+  const char *blob = "#WCB1 0\ntext=0123456789abc\n#END\n";
+  CHECK(!conf.importChunk(state, (const uint8_t *)blob, strlen(blob)));
+  CHECK(!conf.endImport(state));
+  CHECK_STRING(conf.getValue("text"), "x");
+  String name = "#WCB1 0\ndeviceName=";
+  for (uint16_t i = 0; i <= WEBCONFIG_MAXLENGTH; i++)
+    name += 'n';
+  name += "\n#END\n";
+  CHECK(!importBlob(conf, name));
+}
+
+// a restore whose commit fails is reverted
+static void testRestoreCommitFails()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(RESTORESCHEMA);
+  conf.setValue("text", "old");
+  CHECK(conf.flush());
+  uint32_t version = conf.getVersion();
+  String deviceName = conf.getDeviceName();
+  storage.fail = true;
+  CHECK(!importBlob(conf, "#WCB1 0\ndeviceName=other\ntext=new\nnum=7\n#END\n"));
+  CHECK_STRING(conf.getValue("text"), "old");
+  CHECK_STRING(conf.getValue("num"), "1");
+  CHECK_STRING(conf.getDeviceName(), deviceName.c_str());
+  CHECK(conf.getVersion() == version);
+  // the old values are written again with the next commit
+  CHECK(conf.isDirty());
+  storage.fail = false;
+  CHECK(conf.flush());
+  CHECK(!conf.isDirty());
+}
+
+// a restore posted to the form
+static void testRestoreRequest()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(RESTORESCHEMA);
+  WebConfigLocalTransport request;
+  request.post = true;
+  request.addArg("wc", "import");
+  request.addArg("plain", "#WCB1 0\ntext=posted\n#END\n");
+  conf.handleFormRequest(&request);
+  CHECK(request.code == 200);
+  CHECK_STRING(conf.getValue("text"), "posted");
+}
+
+//*************************** binary results *********************************
+static const char *BINSCHEMA = "[{\"name\":\"i\",\"type\":\"number\",\"min\":-100000,\"max\":100000,\"default\":\"-200\"},"
+                               "{\"name\":\"f\",\"type\":\"float\",\"default\":\"0.1\"},"
+                               "{\"name\":\"s\",\"default\":\"hi\"},"
+                               "{\"name\":\"c\",\"type\":\"check\",\"default\":\"1\"}]";
+
+// the exact encodings, numbers in the shortest form
+static void testBinaryEncoding()
+{
+  static const uint8_t msgpack[] = {0x84, 0xA1, 'i', 0xD1, 0xFF, 0x38, 0xA1, 'f', 0xCB, 0x3F, 0xB9, 0x99, 0x99, 0x99, 0x99,
+                                    0x99, 0x9A, 0xA1, 's', 0xA2, 'h', 'i', 0xA1, 'c', 0x01};
+  static const uint8_t cbor[] = {0xA4, 0x61, 'i', 0x38, 0xC7, 0x61, 'f', 0xFB, 0x3F, 0xB9, 0x99, 0x99, 0x99, 0x99,
+                                 0x99, 0x9A, 0x61, 's', 0x62, 'h', 'i', 0x61, 'c', 0x01};
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(BINSCHEMA);
+  ByteStream m, c;
+  CHECK(conf.writeResults(m, RESULTS_MSGPACK) == sizeof(msgpack));
+  CHECK(m.equals(msgpack, sizeof(msgpack)));
+  CHECK(conf.writeResults(c, RESULTS_CBOR) == sizeof(cbor));
+  CHECK(c.equals(cbor, sizeof(cbor)));
+  // a float which is exact as float32 is written with 4 bytes
+  conf.setValue("f", "1.5");
+  ByteStream f;
+  conf.writeResults(f, RESULTS_CBOR);
+  CHECK(f.bytes.find("\xFA\x3F\xC0\x00\x00", 0, 5) != std::string::npos);
+}
+
+// values written in one format and read back are unchanged
+static void testBinaryRoundTrip()
+{
+  static const char *ints[] = {"0", "-1", "-32", "-33", "127", "128", "255", "256", "-129", "65535", "65536", "-32769", "100000", "-100000"};
+  static const char *floats[] = {"0.1", "1.5", "-2.25", "3.4028235e+38", "1e-300", "123456.789"};
+  for (uint8_t format = RESULTS_MSGPACK; format <= RESULTS_CBOR; format++)
+  {
+    for (const char *i : ints)
+    {
+      for (const char *f : floats)
+      {
+        TestStorage a, b;
+        WebConfig from(&a), to(&b);
+        from.addDescription(BINSCHEMA);
+        to.addDescription(BINSCHEMA);
+        from.setValue("i", i);
+        from.setValue("f", f);
+        from.setValue("s", "text with \"quotes\" and more than 31 characters");
+        from.setValue("c", "0");
+        ByteStream bytes;
+        from.writeResults(bytes, format);
+        CHECK(to.readValues(bytes, format));
+        CHECK_STRING(to.getValue("i"), from.getValue("i"));
+        CHECK_STRING(to.getValue("f"), from.getValue("f"));
+        CHECK_STRING(to.getValue("s"), from.getValue("s"));
+        CHECK_STRING(to.getValue("c"), "0");
+      }
+    }
+  }
+}
+
+// other encoders may use half floats, booleans and nil
+static void testBinaryRead()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(BINSCHEMA);
+  // CBOR {"f": 1.5 as float16, "c": false, "s": null, "x": 1}
+  static const uint8_t cbor[] = {0xA4, 0x61, 'f', 0xF9, 0x3E, 0x00, 0x61, 'c', 0xF4, 0x61, 's', 0xF6, 0x61, 'x', 0x01};
+  ByteStream c(cbor, sizeof(cbor));
+  CHECK(conf.readValues(c, RESULTS_CBOR));
+  CHECK_STRING(conf.getValue("f"), "1.5");
+  CHECK_STRING(conf.getValue("c"), "0");
+  CHECK_STRING(conf.getValue("s"), "hi");
+  // MessagePack {"c": true, "i": int64 5}
+  static const uint8_t msgpack[] = {0x82, 0xA1, 'c', 0xC3, 0xA1, 'i', 0xD3, 0, 0, 0, 0, 0, 0, 0, 5};
+  ByteStream m(msgpack, sizeof(msgpack));
+  CHECK(conf.readValues(m, RESULTS_MSGPACK));
+  CHECK_STRING(conf.getValue("c"), "1");
+  CHECK_STRING(conf.getValue("i"), "5");
+}
+
+// no map or truncated data is rejected, fields before the error are kept
+static void testBinaryRejected()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(BINSCHEMA);
+  static const uint8_t array[] = {0x91, 0x01};
+  ByteStream a(array, sizeof(array));
+  CHECK(!conf.readValues(a, RESULTS_MSGPACK));
+  static const uint8_t truncated[] = {0x82, 0xA1, 'i', 0x07, 0xA1, 's', 0xA5, 'a', 'b'};
+  ByteStream t(truncated, sizeof(truncated));
+  CHECK(!conf.readValues(t, RESULTS_MSGPACK));
+  CHECK_STRING(conf.getValue("i"), "7");
+  CHECK_STRING(conf.getValue("s"), "hi");
+  ByteStream empty;
+  CHECK(!conf.readValues(empty, RESULTS_CBOR));
+}
+
+//*************************** numbers ****************************************
+// the shortest text reads back as the same number
+static void testNumberText()
+{
+  char buf[NUMBERLENGTH];
+  double d;
+  long l;
+  randomSeed(1);
+  for (uint16_t n = 0; n < 2000; n++)
+  {
+    uint64_t bits = ((uint64_t)random(0x7FFFFFFF) << 33) ^ ((uint64_t)random(0x7FFFFFFF) << 2) ^ random(4);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    if (!isfinite(v))
+      continue;
+    formatDouble(buf, v);
+    CHECK(parseNumber(buf, d) && (d == v));
+    float f = v;
+    if (!isfinite(f))
+      continue;
+    formatFloat(buf, f);
+    CHECK(parseNumber(buf, d) && ((float)d == f));
+  }
+  formatDouble(buf, 0.1);
+  CHECK_STRING(buf, "0.1");
+  formatFloat(buf, 0.1f);
+  CHECK_STRING(buf, "0.1");
+  formatInteger(buf, INT64_MIN);
+  CHECK_STRING(buf, "-9223372036854775808");
+  // the complete text has to be a number
+  CHECK(parseInteger("-42", l) && (l == -42));
+  CHECK(!parseInteger("", l));
+  CHECK(!parseInteger("4x", l));
+  CHECK(!parseInteger("99999999999999999999", l));
+  CHECK(!parseNumber("1e999", d));
+  CHECK(!parseNumber("nan", d));
+  CHECK(!parseNumber("2.5 ", d));
+  // stored values, an empty value is 0
+  CHECK(storedInteger("", l) && (l == 0));
+  CHECK(!storedInteger("4x", l) && (l == 0));
+  CHECK(storedNumber("", d) && (d == 0));
+  CHECK(!storedNumber("x", d) && (d == 0));
+}
+
+// floats survive any number of saves and loads unchanged
+static void testNumberSaveLoad()
+{
+  static const char *floats[] = {"0.1", "1e-07", "3.14159265358979", "-0", "6.02214076e+23"};
+  TestStorage storage;
+  for (const char *f : floats)
+  {
+    WebConfig conf(&storage);
+    conf.addDescription(BINSCHEMA);
+    conf.setValue("f", f);
+    String stored = conf.getValue("f");
+    for (uint8_t n = 0; n < 3; n++)
+    {
+      CHECK(conf.writeConfig());
+      WebConfig loaded(&storage);
+      loaded.addDescription(BINSCHEMA);
+      CHECK(loaded.readConfig());
+      CHECK_STRING(loaded.getValue("f"), stored.c_str());
+      CHECK(loaded.getFloat("f") == conf.getFloat("f"));
+    }
+  }
+  // floats entered in another form are stored in the shortest form
+  WebConfig conf(&storage);
+  conf.addDescription(BINSCHEMA);
+  conf.setValue("f", "0.10000");
+  CHECK_STRING(conf.getValue("f"), "0.1");
+  conf.setValue("f", "1e400");
+  CHECK_STRING(conf.getValue("f"), "0.1");
+}
+
+// numbers are read from the stored text, a value which is no number is 0
+static void testNumberValues()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(BINSCHEMA);
+  CHECK(conf.getInt("i") == -200);
+  CHECK(conf.getFloat("f") == 0.1f);
+  CHECK(conf.getInt("s") == 0);
+  CHECK(conf.getFloat("s") == 0);
+  conf.setValue("i", "100001");
+  CHECK(conf.getInt("i") == 100000);
+  conf.setValue("s", "12");
+  CHECK(conf.getInt("s") == 12);
+  conf.setValue("i", "-7");
+  CHECK(conf.getResults().indexOf("\"i\":-7") >= 0);
+}
+
+// the CSV for nvs_partition_gen.py refuses numbers which do not fit
+static void testNumberCsv()
+{
+  char path[] = "/tmp/wctestXXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  close(fd);
+  NVSCsvStorage csv(path, "ns");
+  CONFIGENTRY entries[] = {{"i", "-12", STORE_INT}, {"f", "0.5", STORE_FLOAT}, {"s", "a\"b", STORE_STRING}};
+  CHECK(csv.store(entries, 3));
+  FILE *f = fopen(path, "r");
+  char text[256] = "";
+  if (f != nullptr)
+  {
+    text[fread(text, 1, sizeof(text) - 1, f)] = 0;
+    fclose(f);
+  }
+  CHECK(strstr(text, "i,data,i32,-12\n") != nullptr);
+  CHECK(strstr(text, "f,data,hex2bin,000000000000e03f\n") != nullptr);
+  CHECK(strstr(text, "s,data,string,\"a\"\"b\"\n") != nullptr);
+  CONFIGENTRY bad[] = {{"i", "12x", STORE_INT}};
+  CHECK(!csv.store(bad, 1));
+  CONFIGENTRY big[] = {{"i", "4294967296", STORE_INT}};
+  CHECK(!csv.store(big, 1));
+  CONFIGENTRY nan[] = {{"f", "nan", STORE_FLOAT}};
+  CHECK(!csv.store(nan, 1));
+  csv.remove();
+}
+
+//*************************** write-behind ***********************************
+// changes are committed once after the quiet period
+static void testWriteBehindQuiet()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  conf.setWriteBehind(30);
+  conf.setValue("text", "a");
+  CHECK(conf.writeConfig());
+  conf.setValue("text", "b");
+  CHECK(conf.writeConfig());
+  conf.loop();
+  CHECK(conf.isDirty());
+  CHECK(storage.stores == 0);
+  delay(40);
+  conf.loop();
+  CHECK(!conf.isDirty());
+  CHECK(storage.stores == 1);
+  // nothing to do without changes
+  conf.loop();
+  CHECK(conf.flush());
+  CHECK(storage.stores == 1);
+}
+
+// the deadline commits even if the changes do not stop
+static void testWriteBehindDeadline()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  conf.setWriteBehind(1000, 30);
+  conf.setValue("num", "2");
+  conf.writeConfig();
+  delay(40);
+  conf.setValue("num", "3");
+  conf.writeConfig();
+  conf.loop();
+  CHECK(storage.stores == 1);
+  // a failed commit stays dirty and is retried, flush() commits at once
+  conf.setValue("num", "4");
+  conf.writeConfig();
+  storage.fail = true;
+  CHECK(!conf.flush());
+  CHECK(conf.isDirty());
+  storage.fail = false;
+  CHECK(conf.flush());
+  CHECK(!conf.isDirty());
+  WebConfig loaded(&storage);
+  loaded.addDescription(FORMSCHEMA);
+  CHECK(loaded.readConfig());
+  CHECK_STRING(loaded.getValue("num"), "4");
+}
+
+//*************************** render *****************************************
+// the form pulled with renderChunk()
+static String renderForm(WebConfig &conf, size_t chunk)
+{
+  std::vector<uint8_t> buf(chunk);
+  String html;
+  size_t n;
+  conf.beginRender();
+  while ((n = conf.renderChunk(buf.data(), chunk)) > 0)
+  {
+    CHECK(n <= chunk);
+    html.concat((const char *)buf.data(), n);
+  }
+  return html;
+}
+
+// the form is the same for every chunk size
+static void testRenderChunks()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  conf.setValue("text", "value");
+  String html = renderForm(conf, 256);
+  CHECK(html.startsWith("<!DOCTYPE HTML>"));
+  CHECK(html.indexOf("</html>") > 0);
+  for (const char *name : {"'text'", "'num'", "'chk'", "'multi'", "'sel'"})
+    CHECK(html.indexOf(String("name=") + name) > 0);
+  CHECK(html.indexOf("value='value'") > 0);
+  for (size_t chunk : {1, 7, 64, 255})
+    CHECK(renderForm(conf, chunk) == html);
+}
+
+// values are escaped and streamed whatever their length
+static void testRenderValues()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription("[{\"name\":\"t\",\"label\":\"a<b\"}]");
+  conf.setValue("t", "'><script>&\"");
+  String html = renderForm(conf, 256);
+  CHECK(html.indexOf("<b>a&lt;b</b>") > 0);
+  CHECK(html.indexOf("value='&#39;&gt;&lt;script&gt;&amp;&quot;'") > 0);
+  CHECK(html.indexOf("<script>&") < 0);
+  std::string value(3000, 'v');
+  conf.setValue("t", value.c_str());
+  html = renderForm(conf, 256);
+  CHECK(html.indexOf(String("value='") + value.c_str() + "' name='t'") > 0);
+  for (size_t chunk : {1, 100, 4000})
+    CHECK(renderForm(conf, chunk) == html);
+}
+
+// values longer than any buffer, a textarea, the device name and the index
+static void testRenderLong()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription("[{\"name\":\"area\",\"type\":\"textarea\",\"min\":20,\"max\":5}]");
+  std::string area(2000, 'a');
+  conf.setValue("area", area.c_str());
+  String html = renderForm(conf, 256);
+  CHECK(html.indexOf(String("name='area'>") + area.c_str() + "</textarea>") > 0);
+  WebConfigLocalTransport request;
+  std::string name(WEBCONFIG_MAXLENGTH, 'n');
+  request.addArg("deviceName", name.c_str());
+  conf.handleFormRequest(&request);
+  CHECK(strlen(conf.getDeviceName()) < WEBCONFIG_MAXLENGTH);
+  name.resize(3000);
+  request.clear();
+  request.addArg("deviceName", name.c_str());
+  conf.handleFormRequest(&request);
+  CHECK_STRING(conf.getDeviceName(), name.c_str());
+  CHECK(request.body.indexOf(String("ESP Config Portal ") + name.c_str() + "</div>") > 0);
+  conf.mount("/config", "Config");
+  WebConfig other(&storage);
+  other.mount("/other");
+  request.clear();
+  request.chunkSize = 100;
+  WebConfig::handleIndex(&request);
+  CHECK(request.body.indexOf(String("ESP Config Portal ") + name.c_str() + "</div>") > 0);
+  CHECK(request.body.indexOf("<form") < 0);
+  CHECK(request.body.indexOf("<a href='/config'>Config</a>") > 0);
+  CHECK(request.body.indexOf("<a href='/other'>/other</a>") > 0);
+  CHECK(request.body.endsWith("</div></body></html>\n"));
+}
+
+// a section or a field list renders only these fields
+static void testRenderPartial()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription("[{\"name\":\"a\",\"section\":\"One\"},{\"name\":\"b\"},{\"name\":\"c\",\"section\":\"Two\"},"
+                      "{\"name\":\"d\",\"section\":\"x'&y\"}]");
+  CHECK(renderForm(conf, 256).indexOf("<a href='?wcsection=x%27%26y'>x&#39;&amp;y</a>") > 0);
+  WebConfigLocalTransport request;
+  request.addArg("wcsection", "Two");
+  conf.handleFormRequest(&request);
+  CHECK(request.body.indexOf("name='c'") > 0);
+  CHECK(request.body.indexOf("name='a'") < 0);
+  request.clear();
+  request.addArg("wcfields", "a,b");
+  conf.handleFormRequest(&request);
+  CHECK(request.body.indexOf("name='a'") > 0);
+  CHECK(request.body.indexOf("name='b'") > 0);
+  CHECK(request.body.indexOf("name='c'") < 0);
+  // a partial submit does not clear the fields not shown
+  request.clear();
+  request.post = true;
+  request.addArg("wc", "submit");
+  request.addArg("wcfields", "c");
+  request.addArg("plain", "a=x&c=y&SAVE=");
+  conf.handleFormRequest(&request);
+  CHECK_STRING(conf.getValue("a"), "0");
+  CHECK_STRING(conf.getValue("c"), "y");
+}
+
+//*************************** footprint **************************************
+// the cached results and the strings of the instance are counted
+static void testFootprint()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  WebConfigFootprint f = conf.getFootprint();
+  CHECK(f.results == 0);
+  CHECK(f.backends == 0);
+  conf.getResultsJson();
+  conf.mount("/config", "Config");
+  WebConfigFootprint g = conf.getFootprint();
+  CHECK(g.results > 0);
+  CHECK(g.strings == f.strings + strlen("/config") + 1 + strlen("Config") + 1);
+  CHECK(g.total() == g.object + g.heap());
+  CHECK(g.heap() >= g.descriptions + g.values + g.options + g.defaults + g.results);
+}
+
+//*************************** schema cache ***********************************
+static const char *CACHESCHEMA = "[{\"name\":\"host\",\"label\":\"Host\",\"section\":\"net\",\"default\":\"h\"},"
+                                 "{\"name\":\"port\",\"type\":\"number\",\"min\":1,\"max\":65535,"
+                                 "\"default\":\"80\",\"section\":\"net\"},"
+                                 "{\"name\":\"mode\",\"type\":\"select\",\"default\":\"b\",\"section\":\"run\","
+                                 "\"options\":[{\"v\":\"a\",\"l\":\"A\"},{\"v\":\"b\",\"l\":\"B\"}]},"
+                                 "{\"name\":\"flags\",\"type\":\"multicheck\",\"default\":\"01\","
+                                 "\"options\":[{\"v\":\"x\"},{\"v\":\"y\"}]}]";
+
+// counts the blobs written
+class BlobStorage : public TestStorage {
+  public:
+  boolean storeBlob(const char *key, const uint8_t *data, size_t len) override
+  {
+    blobStores++;
+    return TestStorage::storeBlob(key, data, len);
+  }
+  unsigned int blobStores = 0;
+};
+
+// the schema as sent to the browser, the form and the values
+static String schemaOf(WebConfig &conf)
+{
+  WebConfigLocalTransport request;
+  request.addArg("wc", "schema");
+  conf.handleFormRequest(&request);
+  String all = request.body + renderForm(conf, 256);
+  for (uint8_t i = 0; i < conf.getCount(); i++)
+    all += String(conf.getValue(conf.getDescription(i)->name)) + ";";
+  return all;
+}
+
+// the first description is parsed without cache, the second is cached
+static void addCached(WebConfig &conf)
+{
+  conf.addDescription(FORMSCHEMA);
+  conf.setSchemaCache(true);
+  conf.addDescription(CACHESCHEMA);
+}
+
+// a cached load gives the same descriptions as the parser
+static void testSchemaCache()
+{
+  BlobStorage storage;
+  String parsed;
+  {
+    WebConfig conf(&storage);
+    conf.addDescription(FORMSCHEMA);
+    conf.addDescription(CACHESCHEMA);
+    parsed = schemaOf(conf);
+  }
+  {
+    WebConfig conf(&storage);
+    addCached(conf);
+    CHECK(storage.blobStores == 1);
+    CHECK(schemaOf(conf) == parsed);
+  }
+  size_t len = storage.blobSize("wcschema5");
+  CHECK(len > 0);
+  WebConfig conf(&storage);
+  addCached(conf);
+  // loaded from the cache, nothing is written
+  CHECK(storage.blobStores == 1);
+  CHECK(schemaOf(conf) == parsed);
+  CHECK(conf.getIndex("mode") == 7);
+  // a changed schema is parsed again
+  String changed = CACHESCHEMA;
+  changed.replace("\"Host\"", "\"Server\"");
+  WebConfig other(&storage);
+  other.addDescription(FORMSCHEMA);
+  other.setSchemaCache(true);
+  other.addDescription(changed);
+  CHECK(storage.blobStores == 2);
+  CHECK_STRING(other.getDescription(5)->label, "Server");
+}
+
+// a truncated cache is rejected without leftovers, the schema is parsed
+// and the cache written again
+static void testSchemaCacheTruncated()
+{
+  BlobStorage storage;
+  String parsed;
+  {
+    WebConfig conf(&storage);
+    addCached(conf);
+    parsed = schemaOf(conf);
+  }
+  size_t len = storage.blobSize("wcschema5");
+  std::vector<uint8_t> blob(len);
+  CHECK(storage.loadBlob("wcschema5", blob.data(), len));
+  for (size_t cut = 1; cut < len; cut++)
+  {
+    CHECK(storage.storeBlob("wcschema5", blob.data(), cut));
+    unsigned int stores = storage.blobStores;
+    WebConfig conf(&storage);
+    addCached(conf);
+    CHECK(conf.getCount() == 9);
+    CHECK(schemaOf(conf) == parsed);
+    CHECK(storage.blobStores == stores + 1);
+    CHECK(storage.blobSize("wcschema5") == len);
+  }
+}
+
+//*************************** validation *************************************
+// values are checked and brought into their stored form by their type
+static void testValidation()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription("[{\"name\":\"d\",\"type\":\"date\",\"default\":\"\"},"
+                      "{\"name\":\"t\",\"type\":\"time\",\"default\":\"\"},"
+                      "{\"name\":\"col\",\"type\":\"color\",\"default\":\"#000000\"},"
+                      "{\"name\":\"r\",\"type\":\"range\",\"min\":1,\"max\":9,\"default\":\"5\"}]");
+  conf.addDescription(FORMSCHEMA);
+  struct {
+    const char *name;
+    const char *value;
+    const char *stored;
+  } cases[] = {{"d", "2024-02-29", "2024-02-29"}, {"d", "2024-2-29", "2024-02-29"}, {"d", "", ""},
+               {"t", "12:30", "12:30"}, {"t", "12:30:15", "12:30:15"}, {"t", "1230", "12:30:15"},
+               {"col", "#a0B1c2", "#a0B1c2"}, {"col", "red", "#a0B1c2"},
+               {"r", "0", "1"}, {"r", "10", "9"}, {"r", "x", "9"},
+               {"chk", "on", "1"}, {"chk", "0", "0"}, {"chk", "", "0"},
+               {"multi", "1", "100"}, {"multi", "0101", "100"}, {"multi", "2", "100"},
+               {"sel", "b", "b"}, {"sel", "c", "b"}};
+  for (auto &c : cases)
+  {
+    conf.setValue(c.name, c.value);
+    CHECK_STRING(conf.getValue(c.name), c.stored);
+  }
+  // fields named like request arguments or the profile key are ignored
+  uint8_t count = conf.getCount();
+  conf.addDescription("[{\"name\":\"name\"},{\"name\":\"since\"},{\"name\":\"hash\"},{\"name\":\"_profile\"},{\"name\":\"ok\"}]");
+  CHECK(conf.getCount() == count + 1);
+  CHECK(conf.getIndex("name") < 0);
+  // a value longer than 255 characters is rejected, not looped over
+  conf.setValue("multi", std::string(300, '0').c_str());
+  CHECK_STRING(conf.getValue("multi"), "100");
+}
+
+//*************************** delta sync *************************************
+// the changes since a version, all fields for another epoch
+static void testDelta()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  uint32_t epoch = conf.getEpoch();
+  // version 0 asks for all fields
+  conf.setValue("text", "t");
+  uint32_t base = conf.getVersion();
+  conf.setValue("num", "9");
+  CHECK(conf.getVersion() == base + 1);
+  CHECK(conf.getFieldVersion("num") == base + 1);
+  CHECK(conf.getFieldVersion("text") == base);
+  CHECK(conf.getFieldVersion("chk") == 0);
+  // an unchanged value is no change
+  conf.setValue("num", "9");
+  CHECK(conf.getVersion() == base + 1);
+  String delta = conf.getChangesJson(base, epoch);
+  CHECK(delta.indexOf("\"num\":\"9\"") > 0);
+  CHECK(delta.indexOf("\"text\"") < 0);
+  CHECK(conf.getChangesJson(conf.getVersion(), epoch).indexOf("\"num\"") < 0);
+  String all = conf.getChangesJson(conf.getVersion(), epoch + 1);
+  CHECK((all.indexOf("\"num\"") > 0) && (all.indexOf("\"text\"") > 0));
+}
+
+// a batch is applied completely or not at all
+static void testDeltaApply()
+{
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  char epoch[12], base[12];
+  snprintf(epoch, sizeof(epoch), "%lu", (unsigned long)conf.getEpoch());
+  snprintf(base, sizeof(base), "%lu", (unsigned long)conf.getVersion());
+  WebConfigLocalTransport request;
+  request.post = true;
+  request.addArg("wc", "apply");
+  request.addArg("epoch", epoch);
+  request.addArg("base", base);
+  request.addArg("text", "batch");
+  request.addArg("num", "5");
+  conf.handleFormRequest(&request);
+  CHECK(request.code == 200);
+  CHECK(storage.stores == 1);
+  CHECK_STRING(conf.getValue("num"), "5");
+  // the same base again conflicts with the batch just applied
+  request.clear();
+  request.post = true;
+  request.addArg("wc", "apply");
+  request.addArg("epoch", epoch);
+  request.addArg("base", base);
+  request.addArg("num", "6");
+  conf.handleFormRequest(&request);
+  CHECK(request.code == 409);
+  CHECK_STRING(conf.getValue("num"), "5");
+  // an invalid value rejects the whole batch
+  snprintf(base, sizeof(base), "%lu", (unsigned long)conf.getVersion());
+  request.clear();
+  request.post = true;
+  request.addArg("wc", "apply");
+  request.addArg("epoch", epoch);
+  request.addArg("base", base);
+  request.addArg("text", "other");
+  request.addArg("num", "x");
+  conf.handleFormRequest(&request);
+  CHECK(request.code == 422);
+  CHECK(request.body.indexOf("num") > 0);
+  CHECK_STRING(conf.getValue("text"), "batch");
+}
+
+//*************************** type registry **********************************
+// a percentage, a trailing % is removed
+static boolean validatePercent(WebConfig &conf, uint8_t index, String &value)
+{
+  long v;
+  if (value.endsWith("%"))
+    value.remove(value.length() - 1);
+  return parseInteger(value.c_str(), v) && (v >= 0) && (v <= 100);
+}
+
+static void renderPercent(WebConfig &conf, uint8_t index, uint16_t step, const char *value, WebConfigWriter &out)
+{
+  out.printTemplate("<div class='zeile'><input type='number' name='%s' value='%s'>%%</div>\n",
+                    conf.getDescription(index)->name, value);
+  // a part longer than any chunk
+  for (int i = 0; i < 300; i++)
+    out.print("<!-- -->");
+}
+
+static const WebConfigType percentType = {"percent", "number", STORE_INT, STORE_INT, POST_VALUE, validatePercent, nullptr, renderPercent};
+
+// an added type is used by name in the schema
+static void testTypeRegistry()
+{
+  static uint8_t percent = WebConfig::addType(&percentType);
+  CHECK(percent >= INPUTTYPES);
+  TestStorage storage;
+  WebConfig conf(&storage);
+  conf.addDescription("[{\"name\":\"p\",\"type\":\"percent\",\"default\":\"10\"},{\"name\":\"u\",\"type\":\"nosuch\"}]");
+  CHECK(conf.getDescription(0)->type == percent);
+  // unknown types are text fields
+  CHECK(conf.getDescription(1)->type == 0);
+  conf.setValue("p", "55%");
+  CHECK_STRING(conf.getValue("p"), "55");
+  conf.setValue("p", "101");
+  CHECK_STRING(conf.getValue("p"), "55");
+  CHECK(conf.getResults().indexOf("\"p\":55") > 0);
+  String html = renderForm(conf, 256);
+  CHECK(html.indexOf("name='p' value='55'>%") > 0);
+  std::string comments;
+  for (int i = 0; i < 300; i++)
+    comments += "<!-- -->";
+  CHECK(html.indexOf(String(comments.c_str()) + "  <div") > 0);
+  for (size_t chunk : {1, 100, 2500})
+    CHECK(renderForm(conf, chunk) == html);
+  WebConfigFormState *form = conf.beginForm();
+  conf.formChunk(form, (const uint8_t *)"p=77%25", 7);
+  CHECK(conf.endForm(form) == 0);
+  CHECK(conf.getInt("p") == 77);
+}
+
+//*************************** profiles ***************************************
+// a switch exchanges the values without writing the config again
+static void testProfiles()
+{
+  TestStorage storage;
+  {
+    WebConfig conf(&storage);
+    conf.addDescription(FORMSCHEMA);
+    conf.setValue("text", "home");
+    CHECK(conf.writeConfig());
+    CHECK(conf.addProfile("work"));
+    CHECK(conf.getProfileCount() == 2);
+    CHECK_STRING(conf.getProfile(), "default");
+    CHECK(conf.selectProfile("work"));
+    conf.setValue("text", "office");
+    CHECK(conf.writeConfig());
+    unsigned int stores = storage.stores;
+    CHECK(conf.selectProfile("default"));
+    CHECK(storage.stores == stores);
+    CHECK_STRING(conf.getValue("text"), "home");
+    CHECK(conf.getResults("work").indexOf("\"text\":\"office\"") > 0);
+    CHECK(!conf.removeProfile("default"));
+    CHECK(!conf.selectProfile("nosuch"));
+    CHECK(conf.selectProfile("work"));
+  }
+  // the active profile and the values of all profiles are restored
+  WebConfig conf(&storage);
+  conf.addDescription(FORMSCHEMA);
+  CHECK(conf.readConfig());
+  CHECK_STRING(conf.getProfile(), "work");
+  CHECK_STRING(conf.getValue("text"), "office");
+  CHECK(conf.getResults("default").indexOf("\"text\":\"home\"") > 0);
+  CHECK(storage.blobSize("wcp_default") > 0);
+  CHECK(conf.removeProfile(conf.getProfileName(0)));
+  CHECK(conf.getProfileCount() == 1);
+  CHECK(storage.blobSize("wcp_default") == 0);
+  CHECK(storage.removeBlob("nosuch"));
+  // names are encoded in the link and the script and escaped as label
+  CHECK(conf.addProfile("a'b<\"c"));
+  String html = renderForm(conf, 256);
+  CHECK(html.indexOf("name=a%27b%3C%22c';this.form.submit()\">a&#39;b&lt;&quot;c</button>") > 0);
+  CHECK(html.indexOf("a'b") < 0);
+  // a switch needs a POST
+  WebConfigLocalTransport request;
+  request.addArg("wc", "profile");
+  request.addArg("name", "work");
+  conf.handleFormRequest(&request);
+  CHECK(request.code == 405);
+}
+
+typedef struct {
+  const char *name;
+  void (*run)();
+} TESTCASE;
+
+static const TESTCASE tests[] = {
+    {"formSplit", testFormSplit},
+    {"formBytes", testFormBytes},
+    {"formInvalid", testFormInvalid},
+    {"formConcurrent", testFormConcurrent},
+    {"formRequest", testFormRequest},
+    {"observers", testObservers},
+    {"transport", testTransport},
+    {"ramStorage", testRAMStorage},
+    {"posixStorage", testPosixStorage},
+    {"nvsStorage", testNVSStorage},
+    {"nvsRollback", testNVSRollback},
+    {"restoreRoundTrip", testRestoreRoundTrip},
+    {"restoreRejected", testRestoreRejected},
+    {"restoreLength", testRestoreLength},
+    {"restoreCommitFails", testRestoreCommitFails},
+    {"restoreRequest", testRestoreRequest},
+    {"binaryEncoding", testBinaryEncoding},
+    {"binaryRoundTrip", testBinaryRoundTrip},
+    {"binaryRead", testBinaryRead},
+    {"binaryRejected", testBinaryRejected},
+    {"numberText", testNumberText},
+    {"numberSaveLoad", testNumberSaveLoad},
+    {"numberValues", testNumberValues},
+    {"numberCsv", testNumberCsv},
+    {"writeBehindQuiet", testWriteBehindQuiet},
+    {"writeBehindDeadline", testWriteBehindDeadline},
+    {"renderChunks", testRenderChunks},
+    {"renderValues", testRenderValues},
+    {"renderLong", testRenderLong},
+    {"renderPartial", testRenderPartial},
+    {"footprint", testFootprint},
+    {"schemaCache", testSchemaCache},
+    {"schemaCacheTruncated", testSchemaCacheTruncated},
+    {"validation", testValidation},
+    {"delta", testDelta},
+    {"deltaApply", testDeltaApply},
+    {"typeRegistry", testTypeRegistry},
+    {"profiles", testProfiles}};
+
+int main(int argc, char *argv[])
+{
+  for (const TESTCASE &t : tests)
+  {
+    if ((argc > 1) && (strcmp(argv[1], t.name) != 0))
+      continue;
+    unsigned int before = failures;
+    t.run();
+    printf("%-20s %s\n", t.name, (failures == before) ? "ok" : "FAILED");
+  }
+  printf("%u checks, %u failed\n", checks, failures);
+  return (failures > 0) ? 1 : 0;
+}
@@ -15,17 +15,13 @@ Dependencies:
 
 #include <WebConfig.h>
 #include <Arduino.h>
-#if defined(ESP32)
-#include "LittleFS.h"
-#include <WebServer.h>
-#else
-#include <ESP8266WebServer.h>
+#include <math.h>
+#include <stdarg.h>
+#if defined(ESP32) || defined(ESP8266)
+#include <LittleFS.h>
 #endif
 #include <ArduinoJson.h>
-#include <FS.h>
-#include "Preferences.h"
 
-const char *inputtypes[] = {"text", "password", "number", "date", "time", "range", "check", "radio", "select", "color", "float"};
 
 // HTML templates
 // Template for header and begin of form
@@ -65,8 +61,7 @@ const char HTML_START[] PROGMEM =
     "</head>\n"
     "<body>\n"
     "<div id='main_div' style='margin-left:15px;margin-right:15px;'>\n"
-    "<div class='titel'>ESP Config Portal %s</div>\n"
-    "<form method='post'>\n";
+    "<div class='titel'>ESP Config Portal %s</div>\n";
 
 // Template for one input field
 const char HTML_TEX_SIMPLE[] PROGMEM =
@@ -127,10 +122,129 @@ const char HTML_END[] PROGMEM =
     "</div>\n"
     "</body>\n"
     "</html>\n";
+// Template for a link on the index page
+const char HTML_INDEX_ENTRY[] PROGMEM =
+    "<div class='zeile'><a href='%s'>%s</a></div>\n";
+
 // Template for save button and end of the form without save
 const char HTML_BUTTON[] PROGMEM =
     "<button type='submit' name='%s'>%s</button>\n";
 
+// Template for a profile button, the form is posted to switch the
+// profile. It is no submit button, so Enter still saves the form. The
+// name follows URL encoded inside the JavaScript string, then the label
+const char HTML_PROFILE_BUTTON[] PROGMEM =
+    "<button type='button' style='width:auto' onclick=\"this.form.action='?wc=profile&name=";
+const char HTML_PROFILE_BUTTON_END[] PROGMEM =
+    "';this.form.submit()\">%s</button> ";
+
+// Script of the HTML form to apply changes pushed by the device
+// parameters are version, epoch and schema hash
+const char HTML_LIVE[] PROGMEM =
+    "<script>\n"
+    "(function(){var u=location.pathname,N=%lu,P=%lu,H=%lu,F=document.forms[0];\n"
+    "function put(n,v){Array.prototype.forEach.call(F.elements,function(e){\n"
+    " if((e.name!=n)||(e==document.activeElement))return;\n"
+    " if(e.type=='radio')e.checked=(e.value==v);\n"
+    " else if(e.type=='checkbox')e.checked=(e.parentNode.tagName=='FIELDSET')?(v.charAt(e.value)=='1'):(v!='0');\n"
+    " else e.value=v})}\n"
+    "function delta(v){if((v.epoch!=P)||(v.h!=H)){location.replace(u);return}\n"
+    " if(v.d!=null)put('deviceName',v.d);for(var n in v.v)put(n,v.v[n]);N=v.ver}\n"
+    "function poll(){setTimeout(function(){fetch(u+'?wc=changes&since='+N+'&epoch='+P)\n"
+    " .then(function(r){return r.json()}).then(delta).then(poll,poll)},2000)}\n"
+    "if(!window.EventSource){poll();return}\n"
+    "var s=new EventSource(u+'?wc=events&since='+N+'&epoch='+P);\n"
+    "s.onmessage=function(m){delta(JSON.parse(m.data))};\n"
+    "s.onerror=function(){if(s.readyState==2)poll()}})();\n"
+    "</script>\n";
+
+// Static page for client side rendering, the form is built by the
+// browser from the schema and the values requested as JSON. The values
+// are posted as application/x-wc-form, so the web servers pass the body
+// unparsed and it is decoded into the fields, see formChunk()
+const char HTML_SHELL[] PROGMEM =
+    "<!DOCTYPE HTML>\n"
+    "<html>\n"
+    "<head>\n"
+    "<meta http-equiv='Content-Type' content='text/html; charset=utf-8'>\n"
+    "<meta name='viewport' content='width=320' />\n"
+    "<title>ESP Config Portal</title>\n"
+    "<style>\n"
+    "body {background-color:#d2f3eb;font-family:Arial,Helvetica,Sans-Serif;font-size:12pt;width:320px;}\n"
+    ".titel {font-weight:bold;text-align:center;width:100%;padding:5px;}\n"
+    ".zeile {width:100%;padding:5px;text-align:center;}\n"
+    "button {font-size:14pt;width:150px;border-radius:10px;margin:5px;}\n"
+    "</style>\n"
+    "</head>\n"
+    "<body>\n"
+    "<div id='main_div' style='margin-left:15px;margin-right:15px;'>\n"
+    "<div class='titel' id='t'>ESP Config Portal</div>\n"
+    "<form id='f' method='post'></form>\n"
+    "<div class='zeile'><b id='m'></b></div>\n"
+    "</div>\n"
+    "<script>\n"
+    "var u=location.pathname,S,N,P,L,F=document.getElementById('f'),M=document.getElementById('m');\n"
+    "function g(q){return fetch(u+'?wc='+q).then(function(r){return r.json()})}\n"
+    "function z(p,t){var e=document.createElement(t);p.appendChild(e);return e}\n"
+    "function x(p,s){p.appendChild(document.createTextNode(s))}\n"
+    "function row(){var e=z(F,'div');e.className='zeile';return e}\n"
+    "function inp(p,t,n,v){var e=z(p,'input');e.type=t;e.name=n;if(v!=null)e.value=v;return e}\n"
+    "function build(){\n"
+    " var r,e;F.innerHTML='';\n"
+    " if(S.b==0){z(row(),'b').textContent='device Name';inp(row(),'text','deviceName')}\n"
+    " S.f.forEach(function(f){\n"
+    "  var o=f.o||[];\n"
+    "  if(f.t==6){r=row();z(r,'b').textContent=f.l;inp(r,'checkbox',f.n);return}\n"
+    "  z(row(),'b').textContent=f.l;\n"
+    "  if(f.t==7){o.forEach(function(p){r=row();inp(r,'radio',f.n,p[0]);x(r,p[1])});return}\n"
+    "  r=row();\n"
+    "  if(f.t==8){e=z(r,'select');e.name=f.n;o.forEach(function(p){var c=z(e,'option');c.value=p[0];c.textContent=p[1]});return}\n"
+    "  if(f.t==12){e=z(r,'fieldset');e.style.textAlign='left';o.forEach(function(p,i){inp(e,'checkbox',f.n,i);x(e,p[1]);z(e,'br')});return}\n"
+    "  if(f.t==11){e=z(r,'textarea');e.name=f.n;e.rows=f.a;e.cols=f.i;e.maxLength=f.m;return}\n"
+    "  if(f.t==5)x(r,f.i+String.fromCharCode(160));\n"
+    "  e=inp(r,f.y||'text',f.n);e.maxLength=f.m;\n"
+    "  if((f.t==2)||(f.t==5)){e.min=f.i;e.max=f.a}\n"
+    "  if(f.t==5)x(r,String.fromCharCode(160)+f.a);\n"
+    " });\n"
+    " r=row();\n"
+    " [['SAVE','Save',0],['RST','Restart',0],['DONE','Done',1],['CANCEL','Cancel',2],['DELETE','Delete',4]].forEach(function(b){\n"
+    "  if((S.b==0)?(b[2]==0):(S.b&b[2])){e=z(r,'button');e.type='submit';e.name=b[0];e.textContent=b[1]}});\n"
+    "}\n"
+    "function put(n,v){Array.prototype.forEach.call(F.elements,function(e){\n"
+    " if((e.name!=n)||(e==document.activeElement))return;\n"
+    " if(e.type=='radio')e.checked=(e.value==v);\n"
+    " else if(e.type=='checkbox')e.checked=(e.parentNode.tagName=='FIELDSET')?(v.charAt(e.value)=='1'):(v!='0');\n"
+    " else e.value=v})}\n"
+    "function apply(v){\n"
+    " if(v.d!=null){document.getElementById('t').textContent='ESP Config Portal '+v.d;put('deviceName',v.d)}\n"
+    " for(var n in v.v)put(n,v.v[n]);N=v.ver;P=v.epoch}\n"
+    "function load(){g('values').then(function(v){\n"
+    " return ((S&&(S.h==v.h))?Promise.resolve():g('schema&h='+v.h).then(function(s){S=s;\n"
+    "  return Promise.all(s.f.map(function(f,i){return f.p&&g('options&f='+i).then(function(o){f.o=o})}))}).then(build))\n"
+    "  .then(function(){apply(v);if(!L)listen()})})}\n"
+    "function delta(v){if((v.epoch!=P)||(v.h!=S.h))load();else apply(v)}\n"
+    "function poll(){setTimeout(function(){g('changes&since='+N+'&epoch='+P).then(delta).then(poll,poll)},2000)}\n"
+    "function listen(){\n"
+    " L=1;if(!window.EventSource){poll();return}\n"
+    " var s=new EventSource(u+'?wc=events&since='+N+'&epoch='+P);\n"
+    " s.onmessage=function(m){delta(JSON.parse(m.data))};\n"
+    " s.onerror=function(){if(s.readyState==2)poll()}}\n"
+    "F.onsubmit=function(ev){\n"
+    " if(!ev.submitter||(ev.submitter.name!='SAVE'))return;\n"
+    " ev.preventDefault();\n"
+    " var d=new URLSearchParams(new FormData(F));d.append('SAVE','');\n"
+    " fetch(u+'?wc=submit',{method:'POST',headers:{'Content-Type':'application/x-wc-form'},body:d.toString()}).then(function(r){return r.json()}).then(function(v){\n"
+    "  M.textContent=((v.i>0)?'INVALID INPUT IGNORED! ':'')+(v.e?'ERROR IN SAVING':(v.s?'SAVED!':''));\n"
+    "  delta(v)})}\n"
+    "load();\n"
+    "</script>\n"
+    "</body>\n"
+    "</html>\n";
+
+// buttons of a form in addition to BTN_DONE, BTN_CANCEL and BTN_DELETE
+#define BTN_SAVE 8
+#define BTN_RST 16
+
 #define INPUTTEXT 0
 #define INPUTPASSWORD 1
 #define INPUTNUMBER 2
@@ -145,22 +259,142 @@ const char HTML_BUTTON[] PROGMEM =
 #define INPUTTEXTAREA 11
 #define INPUTMULTICHECK 12
 
-WebConfig::WebConfig(boolean NVS, const char *NVSNamespace) : isNVS(NVS), nameSpace(NVSNamespace)
+// arguments of the form requests and the config key of the active
+// profile, fields with these names are rejected
+static const char *const RESERVEDNAMES[] = {"wc", "deviceName", "SAVE", "RST", "DONE", "CANCEL", "DELETE", "plain", "base", "epoch",
+                                            "wcsection", "wcfields", "since", "hash", "name", "_profile"};
+
+static boolean reservedName(const char *name)
+{
+  for (uint8_t i = 0; i < sizeof(RESERVEDNAMES) / sizeof(RESERVEDNAMES[0]); i++)
+  {
+    if (strcmp(name, RESERVEDNAMES[i]) == 0)
+      return true;
+  }
+  return false;
+}
+
+std::function<uint32_t()> WebConfig::_allocationCounter{ nullptr };
+// build flag WEBCONFIG_BUDGET=<bytes> checks the static RAM of one instance
+#if defined(WEBCONFIG_BUDGET)
+WEBCONFIG_ASSERT_BUDGET(1, WEBCONFIG_BUDGET);
+#endif
+WebConfig *WebConfig::_instances = nullptr;
+OPTIONTABLE *WebConfig::_optionTables = nullptr;
+#if defined(ESP32)
+// created once with the static objects before any task can take it
+SemaphoreHandle_t WebConfig::_lock = xSemaphoreCreateRecursiveMutex();
+#endif
+
+WebConfig::WebConfig(boolean NVS, const char *NVSNamespace) : isNVS(NVS)
 {
   _deviceNAme = "";
+  _epoch = random(1, 0x7fffffff);
+  memset(_fieldVersion, 0, sizeof(_fieldVersion));
+#if defined(ESP32)
+  if (NVS)
+    _storage = new NVSStorage(NVSNamespace);
+  else
+    _storage = new LittleFSStorage(CONFFILE);
+#elif defined(ESP8266)
+  _storage = new LittleFSStorage(CONFFILE);
+#else
+  _storage = new RAMStorage();
+#endif
+  _ownStorage = true;
 };
 
-void WebConfig::setDescription(String parameter, WebServer *server)
+WebConfig::WebConfig(WebConfigStorage *storage) : isNVS(false)
+{
+  _deviceNAme = "";
+  _epoch = random(1, 0x7fffffff);
+  memset(_fieldVersion, 0, sizeof(_fieldVersion));
+  _storage = storage;
+}
+
+WebConfig::~WebConfig()
+{
+  lock();
+  // a mounted form leaves the index
+  WebConfig **w = &_instances;
+  while ((*w != nullptr) && (*w != this))
+    w = &(*w)->_nextInstance;
+  if (*w != nullptr)
+    *w = _nextInstance;
+  // the option tables are shared, only the references are dropped
+  for (uint8_t i = 0; i < Staticindex; i++)
+    releaseOptions(_description[i].options);
+  unlock();
+  delete[] _description;
+  clearDefaults();
+  while (_observers != nullptr)
+  {
+    OBSERVER *o = _observers;
+    _observers = o->next;
+    delete o;
+  }
+  while (_providers != nullptr)
+  {
+    PROVIDER *p = _providers;
+    _providers = p->next;
+    delete p;
+  }
+  while (_subscribers != nullptr)
+  {
+    SUBSCRIBER *sub = _subscribers;
+    _subscribers = sub->next;
+    delete sub->stream;
+    delete sub;
+  }
+  while (_profiles != nullptr)
+  {
+    PROFILE *p = _profiles;
+    _profiles = p->next;
+    delete p;
+  }
+  delete _results;
+#if defined(WEBCONFIG_WEBSERVER)
+  delete _serverTransport;
+#endif
+  if (_ownStorage)
+    delete _storage;
+}
+
+// use another storage backend
+void WebConfig::setStorage(WebConfigStorage *storage)
+{
+  if (_ownStorage)
+    delete _storage;
+  _storage = storage;
+  _ownStorage = false;
+}
+
+#if defined(WEBCONFIG_WEBSERVER)
+void WebConfig::setDescription(String parameter, WebServer *server, const char *uri)
 {
+  lock();
+  for (uint8_t i = 0; i < Staticindex; i++)
+    setOptions(i, nullptr);
   Staticindex = 0;
+  unlock();
   addDescription(parameter);
   if (server != nullptr)
   {
     this->_server = server;
-    server->on("/", [&]()
+    mount(uri);
+    server->on(uri, [&]()
                { this->handleRoot(); });
   }
 }
+
+// serve the index page of all mounted forms
+void WebConfig::setIndex(WebServer *server, const char *uri)
+{
+  server->on(uri, [server]()
+             {
+               WebServerTransport transport(server);
+               handleIndex(&transport); });
+}
 bool WebConfig::handleRoot()
 {
   if (_server == nullptr)
@@ -174,7 +408,7 @@ bool WebConfig::handleRoot()
     {
       Serial.print(this->getName(i));
       Serial.print(" = ");
-      Serial.println(this->values[i]);
+      Serial.println(valueOf(i));
     }
     Serial.println("*********** Config done ************");
     return true;
@@ -184,13 +418,75 @@ bool WebConfig::handleRoot()
     return false;
   }
 }
+#endif
 
 void WebConfig::addDescription(String parameter)
+{
+  uint8_t first = Staticindex;
+  if (first == 0)
+  {
+    clearDefaults();
+    _sectionCnt = 0;
+  }
+  uint32_t schemaHash = hashString(parameter.c_str(), (first == 0) ? 2166136261UL : _schemaHash);
+  // storage has to be ready for the schema cache
+  _storage->begin();
+  // the option tables are shared by all instances
+  lock();
+  if (_schemaCache)
+  {
+    uint32_t hash = hashString(parameter.c_str());
+    if (!loadSchema(first, hash))
+    {
+      parseDescription(parameter);
+      storeSchema(first, hash);
+    }
+  }
+  else
+  {
+    parseDescription(parameter);
+  }
+  // the schema hash identifies the schema for cached copies in a browser,
+  // it is set after the options which touch it, a cached schema gets the
+  // same hash as a parsed one
+  _schemaHash = schemaHash;
+  unlock();
+#if defined(WEBCONFIG_WEBSERVER)
+  if (_deviceNAme == "")
+    _deviceNAme = WiFi.macAddress();
+#endif
+  //_deviceNAme.replace(":", "");
+  // with NVS the stored values are loaded together with the descriptions
+  if (isNVS)
+    loadConfig();
+};
+
+// make room for count descriptions, the array grows with addDescription()
+void WebConfig::reserveDescriptions(uint8_t count)
+{
+  if (count > MAXVALUES)
+    count = MAXVALUES;
+  if (count <= _descriptionCap)
+    return;
+  // zeroed like the former member array, a field without label has an
+  // empty one
+  DESCRIPTION *d = new DESCRIPTION[count]();
+  for (uint8_t i = 0; i < _descriptionCap; i++)
+    d[i] = _description[i];
+  delete[] _description;
+  _description = d;
+  _descriptionCap = count;
+}
+
+// create the descriptions from a JSON array
+void WebConfig::parseDescription(const String &parameter)
 {
   DeserializationError error;
   const int capacity = JSON_ARRAY_SIZE(MAXVALUES) + MAXVALUES * JSON_OBJECT_SIZE(8);
   DynamicJsonDocument doc(capacity);
   char tmp[40];
+  String defaults;
+  uint8_t first = Staticindex;
   error = deserializeJson(doc, parameter);
   if (error)
   {
@@ -201,894 +497,3883 @@ void WebConfig::addDescription(String parameter)
   else
   {
     JsonArray array = doc.as<JsonArray>();
+    reserveDescriptions(first + array.size());
     uint8_t j = 0;
     for (JsonObject obj : array)
     {
       if (Staticindex < MAXVALUES)
       {
-        _description[Staticindex].optionCnt = 0;
+        // a field named like an argument of the form would be mixed up with it
+        if (reservedName(obj["name"] | ""))
+        {
+          Serial.printf("ERROR %s is a reserved name, field ignored\n", (const char *)obj["name"]);
+          continue;
+        }
+        setOptions(Staticindex, nullptr);
         if (obj.containsKey("name"))
         {
-          if (isNVS)
-          {
-            strlcpy(tmp, obj["name"], NVS_NAMELENGTH);
-            if (strlen(tmp) > 15)
-            {
-              Serial.printf("WARNING NVS Key Too long!  %s , will be trimmed \n\r", _description[Staticindex].name);
-            }
-            strlcpy(_description[Staticindex].name, obj["name"], NVS_NAMELENGTH);
-          }
-          else
+          uint8_t maxLen = _storage->maxNameLength();
+          if (maxLen >= NAMELENGTH)
+            maxLen = NAMELENGTH - 1;
+          strlcpy(tmp, obj["name"], sizeof(tmp));
+          if (strlen(tmp) > maxLen)
           {
-            strlcpy(_description[Staticindex].name, obj["name"], NAMELENGTH);
+            Serial.printf("WARNING Key Too long!  %s , will be trimmed \n\r", tmp);
           }
+          strlcpy(_description[Staticindex].name, tmp, maxLen + 1);
         }
         if (obj.containsKey("label"))
           strlcpy(_description[Staticindex].label, obj["label"], LABELLENGTH);
         if (obj.containsKey("type"))
         {
+          // unknown types are text fields
           if (obj["type"].is<const char *>())
           {
-            uint8_t t = 0;
             strlcpy(tmp, obj["type"], 30);
-            while ((t < INPUTTYPES) && (strcmp(tmp, inputtypes[t]) != 0))
-              t++;
-            if (t > INPUTTYPES)
-              t = 0;
-            _description[Staticindex].type = t;
+            _description[Staticindex].type = findType(tmp);
           }
           else
           {
-            _description[Staticindex].type = obj["type"];
+            uint8_t t = obj["type"];
+            _description[Staticindex].type = (t < INPUTTYPES + _typeCnt) ? t : INPUTTEXT;
           }
         }
         else
         {
           _description[Staticindex].type = INPUTTEXT;
         }
+        // a field without section belongs to the section of the field before
+        if (obj.containsKey("section"))
+          _description[Staticindex].section = addSection(obj["section"]);
+        else
+          _description[Staticindex].section = (Staticindex > 0) ? _description[Staticindex - 1].section : 0;
         _description[Staticindex].max = (obj.containsKey("max")) ? obj["max"] : 99999;
         _description[Staticindex].min = (obj.containsKey("min")) ? obj["min"] : 0;
-        if (isNVS)
-        {
-
-#if defined(ESP32)
-          switch (_description[Staticindex].type)
-          {
-          case INPUTPASSWORD:
-          case INPUTSELECT:
-          case INPUTDATE:
-          case INPUTTIME:
-          case INPUTRADIO:
-          case INPUTCOLOR:
-          case INPUTTEXT:
-          {
-            values[Staticindex] = getStringNVS(_description[Staticindex].name);
-            if (values[Staticindex] == "")
-            {
-              if (obj.containsKey("default"))
-              {
-                // strlcpy(tmp, obj["default"], 30);
-                values[Staticindex] = String(obj["default"]);
-                Serial.printf("laoded default value %s:%s\n\r", _description[Staticindex].name, values[Staticindex].c_str());
-              }
-            }
-            else 
-            {
-              Serial.printf("laoded from NVS %s:%s\n\r", _description[Staticindex].name, values[Staticindex].c_str());
-            }
-            break;
-          }
-          case INPUTCHECKBOX:
-          case INPUTRANGE:
-          case INPUTNUMBER:
-          {
-            values[Staticindex] = getIntNVS(_description[Staticindex].name);
-            if (values[Staticindex].toInt() == 0x7FFFFFFF)
-            {
-              if (obj.containsKey("default"))
-              {
-                // strlcpy(tmp, obj["default"], 30);
-                values[Staticindex] = String(obj["default"]);
-                Serial.printf("laoded default value %s:%s\n\r", _description[Staticindex].name, values[Staticindex].c_str());
-              }
-            }
-            else 
-            {
-              Serial.printf("laoded from NVS %s:%s\n\r", _description[Staticindex].name, values[Staticindex].c_str());
-            }
-            break;
-          }
-          case INPUTFLOAT:
-          {
-            values[Staticindex] = String(getfloatNVS(_description[Staticindex].name));
-            if (values[Staticindex].toFloat() == 0x7FFFFFFF)
-            {
-              if (obj.containsKey("default"))
-              {
-                // strlcpy(tmp, obj["default"], 30);
-                values[Staticindex] = String(obj["default"]);
-                Serial.printf("laoded default value %s:%s\n\r", _description[Staticindex].name, values[Staticindex].c_str());
-              }
-            }
-            else 
-            {
-              Serial.printf("laoded from NVS %s:%s\n\r", _description[Staticindex].name, values[Staticindex].c_str());
-            }
-            break;
-          }
-          }
-#endif
-        }
+        _description[Staticindex].maxLength = (obj.containsKey("maxlen")) ? obj["maxlen"] : WEBCONFIG_MAXLENGTH;
+        // defaults are collected in one block, see setDefaults()
+        if (obj.containsKey("default"))
+          strlcpy(tmp, obj["default"], 30);
         else
-        {
-          if (obj.containsKey("default"))
-          {
-            strlcpy(tmp, obj["default"], 30);
-            values[Staticindex] = String(tmp);
-          }
-          else
-          {
-            values[Staticindex] = "0";
-          }
-        }
+          strcpy(tmp, "0");
+        defaults.concat(tmp, strlen(tmp) + 1);
         if (obj.containsKey("options"))
         {
+          // the strings stay in the JSON document until the table is created
+          const char *opts[MAXOPTIONS];
+          const char *labs[MAXOPTIONS];
           JsonArray opt = obj["options"].as<JsonArray>();
           j = 0;
           for (JsonObject o : opt)
           {
             if (j < MAXOPTIONS)
             {
-              _description[Staticindex].options[j] = o["v"].as<String>();
-              _description[Staticindex].labels[j] = o["l"].as<String>();
+              opts[j] = o["v"] | "";
+              labs[j] = o["l"] | opts[j];
+              j++;
             }
-            j++;
           }
-          _description[Staticindex].optionCnt = opt.size();
+          setOptions(Staticindex, internOptions(opts, labs, j));
         }
+        Staticindex++;
       }
-      Staticindex++;
     }
+    setDefaults(first, defaults.c_str(), defaults.length());
   }
-  if (isNVS)
+}
+
+// copy the defaults of the fields from first on into one block and set
+// the values. pool holds one zero terminated string per field. The block
+// is in RAM, the schema text cannot be referenced, its defaults are
+// escaped JSON strings and the text is freed after addDescription()
+void WebConfig::setDefaults(uint8_t first, const char *pool, size_t len)
+{
+  DEFAULTBLOCK *b = new DEFAULTBLOCK;
+  b->data = new char[len];
+  memcpy(b->data, pool, len);
+  b->next = _defaultBlocks;
+  _defaultBlocks = b;
+  const char *p = b->data;
+  for (uint8_t i = first; i < Staticindex; i++)
   {
-    _deviceNAme = getStringNVS("deviceName");
+    _defaults[i] = p;
+    p += strlen(p) + 1;
+    _overridden.clear(i);
+    // with copy on write values[] holds only overridden values
+    if (_copyOnWrite)
+      values[i] = String();
+    else
+      values[i] = _defaults[i];
   }
-  else
+}
+
+// free the defaults, setDescription() starts a new schema
+void WebConfig::clearDefaults()
+{
+  while (_defaultBlocks != nullptr)
   {
-    _deviceNAme = WiFi.macAddress();
+    DEFAULTBLOCK *b = _defaultBlocks;
+    _defaultBlocks = b->next;
+    delete[] b->data;
+    delete b;
   }
-  //_deviceNAme.replace(":", "");
-  if (!isNVS)
+}
+
+// store values only if they differ from the defaults, must be called
+// before setDescription()
+void WebConfig::setCopyOnWrite(boolean enable)
+{
+  _copyOnWrite = enable;
+}
+
+// current value of a field, the default if it was not overridden
+const char *WebConfig::valueOf(uint8_t index)
+{
+  if (!_copyOnWrite || _overridden.contains(index))
+    return values[index].c_str();
+  return _defaults[index];
+}
+
+// set a field back to its default value
+void WebConfig::resetValue(const char *name)
+{
+  int16_t i = getIndex(name);
+  if (i >= 0)
   {
-    if (!LittleFS.begin())
-    {
-      LittleFS.format();
-      LittleFS.begin();
-    }
+    lock();
+    updateValue(i, _defaults[i]);
+    unlock();
   }
+}
+
+//************************** schema cache ************************************
+// the descriptions created from one addDescription() call are stored as
+// binary blob wcschema<first index>. It starts with a header
+// 'W' 'C' version count hash(4) followed by the fields:
+// type min(4) max(4) maxlen(2) optionCnt name label default section
+// {option label}
+// strings are stored with a 2 byte length and without terminating zero
+// the version changes with the format and with the checks of the parser,
+// a cache of an older version is parsed again
+#define SCHEMA_VERSION 5
+#define SCHEMA_HEADER 8
+
+// writer for the blob, without buffer only the size is counted
+struct SCHEMAWRITER
+{
+  uint8_t *buf;
+  size_t pos;
 };
 
-void createSimple(char *buf, const char *name, const char *label, const char *type, String value)
+static void schemaPut(SCHEMAWRITER &w, const void *data, size_t len)
 {
-  sprintf(buf, HTML_ENTRY_SIMPLE, label, type, value.c_str(), name);
+  if (w.buf != nullptr)
+    memcpy(w.buf + w.pos, data, len);
+  w.pos += len;
 }
 
-void createTextarea(char *buf, DESCRIPTION descr, String value)
+static void schemaPutString(SCHEMAWRITER &w, const char *s)
 {
-  // max = rows min = cols
-  sprintf(buf, HTML_ENTRY_AREA, descr.label, descr.max, descr.min, descr.name, value.c_str());
+  uint16_t len = strlen(s);
+  schemaPut(w, &len, 2);
+  schemaPut(w, s, len);
 }
 
-void createNumber(char *buf, DESCRIPTION descr, String value)
+// reader for the blob, returns false if the blob is too short
+struct SCHEMAREADER
+{
+  const uint8_t *buf;
+  size_t pos;
+  size_t len;
+};
+
+static boolean schemaGet(SCHEMAREADER &r, void *data, size_t len)
 {
-  sprintf(buf, HTML_ENTRY_NUMBER, descr.label, descr.min, descr.max, value.c_str(), descr.name);
+  if (r.pos + len > r.len)
+    return false;
+  memcpy(data, r.buf + r.pos, len);
+  r.pos += len;
+  return true;
 }
 
-void createRange(char *buf, DESCRIPTION descr, String value)
+static boolean schemaGetString(SCHEMAREADER &r, String &s)
 {
-  sprintf(buf, HTML_ENTRY_RANGE, descr.label, descr.min, descr.min, descr.max, value.c_str(), descr.name, descr.max);
+  uint16_t len;
+  if (!schemaGet(r, &len, 2) || (r.pos + len > r.len))
+    return false;
+  s = "";
+  s.concat((const char *)r.buf + r.pos, len);
+  r.pos += len;
+  return true;
 }
 
-void createCheckbox(char *buf, DESCRIPTION descr, String value)
+static boolean schemaGetString(SCHEMAREADER &r, char *s, size_t size)
 {
-  if (value != "0")
-  {
-    sprintf(buf, HTML_ENTRY_CHECKBOX, descr.label, "checked", descr.name);
-  }
-  else
-  {
-    sprintf(buf, HTML_ENTRY_CHECKBOX, descr.label, "", descr.name);
-  }
+  String tmp;
+  if (!schemaGetString(r, tmp))
+    return false;
+  strlcpy(s, tmp.c_str(), size);
+  return true;
 }
 
-void createRadio(char *buf, DESCRIPTION descr, String value, uint8_t index)
+// cache the schema, must be set before setDescription()
+void WebConfig::setSchemaCache(boolean enable)
 {
-  if (value == descr.options[index])
-  {
-    sprintf(buf, HTML_ENTRY_RADIO, descr.name, descr.options[index].c_str(), "checked", descr.labels[index].c_str());
-  }
-  else
+  _schemaCache = enable;
+}
+
+// write the fields from first to the end into w
+void WebConfig::writeSchema(SCHEMAWRITER &w, uint8_t first, uint32_t hash)
+{
+  uint8_t header[4] = {'W', 'C', SCHEMA_VERSION, (uint8_t)(Staticindex - first)};
+  schemaPut(w, header, 4);
+  schemaPut(w, &hash, 4);
+  for (uint8_t i = first; i < Staticindex; i++)
   {
-    sprintf(buf, HTML_ENTRY_RADIO, descr.name, descr.options[index].c_str(), "", descr.labels[index].c_str());
+    const DESCRIPTION &d = _description[i];
+    int32_t n;
+    schemaPut(w, &d.type, 1);
+    n = d.min;
+    schemaPut(w, &n, 4);
+    n = d.max;
+    schemaPut(w, &n, 4);
+    schemaPut(w, &d.maxLength, 2);
+    schemaPut(w, &d.optionCnt, 1);
+    schemaPutString(w, d.name);
+    schemaPutString(w, d.label);
+    schemaPutString(w, _defaults[i]);
+    schemaPutString(w, (d.section > 0) ? _sections[d.section - 1] : "");
+    for (uint8_t j = 0; j < d.optionCnt; j++)
+    {
+      schemaPutString(w, d.options->option(j));
+      schemaPutString(w, d.options->label(j));
+    }
   }
 }
 
-void startSelect(char *buf, DESCRIPTION descr)
+// store the descriptions created by the last addDescription()
+boolean WebConfig::storeSchema(uint8_t first, uint32_t hash)
 {
-  sprintf(buf, HTML_ENTRY_SELECT_START, descr.label, descr.name);
+  char key[16];
+  SCHEMAWRITER w = {nullptr, 0};
+  writeSchema(w, first, hash);
+  uint8_t *buf = new uint8_t[w.pos];
+  w.buf = buf;
+  w.pos = 0;
+  writeSchema(w, first, hash);
+  snprintf(key, sizeof(key), "wcschema%u", first);
+  boolean ok = _storage->storeBlob(key, buf, w.pos);
+  delete[] buf;
+  return ok;
 }
 
-void addSelectOption(char *buf, String option, String label, String value)
+// load the descriptions from the cache if it was created from the same
+// schema text, returns false if the JSON has to be parsed
+boolean WebConfig::loadSchema(uint8_t first, uint32_t hash)
 {
-  if (option == value)
+  char key[16];
+  uint8_t header[4];
+  uint32_t h;
+  snprintf(key, sizeof(key), "wcschema%u", first);
+  size_t len = _storage->blobSize(key);
+  if (len < SCHEMA_HEADER)
+    return false;
+  uint8_t *buf = new uint8_t[len];
+  String defaults;
+  String def;
+  String section;
+  String opts[MAXOPTIONS];
+  String labs[MAXOPTIONS];
+  const char *optPtr[MAXOPTIONS];
+  const char *labPtr[MAXOPTIONS];
+  uint8_t cnt = 0;
+  // a failed load leaves nothing behind, the description is parsed then
+  uint8_t sectionCnt = _sectionCnt;
+  uint8_t loaded = first;
+  SCHEMAREADER r = {buf, 0, len};
+  boolean ok = _storage->loadBlob(key, buf, len) &&
+               schemaGet(r, header, 4) && schemaGet(r, &h, 4) &&
+               (header[0] == 'W') && (header[1] == 'C') && (header[2] == SCHEMA_VERSION) &&
+               (h == hash) && (first + header[3] <= MAXVALUES);
+  if (ok)
+    reserveDescriptions(first + header[3]);
+  for (uint8_t i = first; ok && (i < first + header[3]); i++)
   {
-    sprintf(buf, HTML_ENTRY_SELECT_OPTION, option.c_str(), "selected", label.c_str());
+    DESCRIPTION &d = _description[i];
+    int32_t min = 0;
+    int32_t max = 0;
+    // the types added by the sketch have to be registered again
+    ok = schemaGet(r, &d.type, 1) && (d.type < INPUTTYPES + _typeCnt) &&
+         schemaGet(r, &min, 4) && schemaGet(r, &max, 4) &&
+         schemaGet(r, &d.maxLength, 2) && schemaGet(r, &cnt, 1) && (cnt <= MAXOPTIONS) &&
+         schemaGetString(r, d.name, NAMELENGTH) &&
+         schemaGetString(r, d.label, LABELLENGTH) &&
+         schemaGetString(r, def) &&
+         schemaGetString(r, section);
+    for (uint8_t j = 0; ok && (j < cnt); j++)
+    {
+      ok = schemaGetString(r, opts[j]) && schemaGetString(r, labs[j]);
+      optPtr[j] = opts[j].c_str();
+      labPtr[j] = labs[j].c_str();
+    }
+    if (ok)
+    {
+      d.min = min;
+      d.max = max;
+      d.section = addSection(section.c_str());
+      defaults.concat(def.c_str(), def.length() + 1);
+      setOptions(i, internOptions(optPtr, labPtr, cnt));
+      loaded = i + 1;
+    }
   }
-  else
+  delete[] buf;
+  if (!ok)
+  {
+    for (uint8_t i = first; i < loaded; i++)
+    {
+      releaseOptions(_description[i].options);
+      _description[i].options = nullptr;
+      _description[i].optionCnt = 0;
+    }
+    _sectionCnt = sectionCnt;
+    return false;
+  }
+  Staticindex = first + header[3];
+  setDefaults(first, defaults.c_str(), defaults.length());
+  return true;
+}
+
+// index of the section with name, 0 if there is no such section
+uint8_t WebConfig::findSection(const char *name)
+{
+  for (uint8_t i = 0; i < _sectionCnt; i++)
   {
-    sprintf(buf, HTML_ENTRY_SELECT_OPTION, option.c_str(), "", label.c_str());
+    if (strcmp(_sections[i], name) == 0)
+      return i + 1;
   }
+  return 0;
 }
 
-void startMulti(char *buf, DESCRIPTION descr)
+// index of the section with name, a new section is added if necessary
+uint8_t WebConfig::addSection(const char *name)
 {
-  sprintf(buf, HTML_ENTRY_MULTI_START, descr.label);
+  if (strlen(name) == 0)
+    return 0;
+  uint8_t i = findSection(name);
+  if ((i == 0) && (_sectionCnt < MAXSECTIONS))
+  {
+    strlcpy(_sections[_sectionCnt], name, NAMELENGTH);
+    i = ++_sectionCnt;
+  }
+  return i;
 }
 
-void addMultiOption(char *buf, String name, uint8_t option, String label, String value)
+// fields selected by ?wcsection=name or ?wcfields=a,b
+// returns false if the whole form is requested
+boolean WebConfig::selectFields(WebConfigTransport *server, WebConfigChanges &fields, uint8_t &section)
 {
-  if ((value.length() > option) && (value[option] == '1'))
+  fields.clear();
+  section = 0;
+  if (server->hasArg(F("wcsection")))
   {
-    sprintf(buf, HTML_ENTRY_MULTI_OPTION, name.c_str(), option, "checked", label.c_str());
+    section = findSection(server->arg(F("wcsection")).c_str());
+    for (uint8_t i = 0; i < Staticindex; i++)
+    {
+      if ((section > 0) && (_description[i].section == section))
+        fields.set(i);
+    }
+    return true;
   }
-  else
+  if (server->hasArg(F("wcfields")))
   {
-    sprintf(buf, HTML_ENTRY_MULTI_OPTION, name.c_str(), option, "", label.c_str());
+    String list = server->arg(F("wcfields"));
+    int start = 0;
+    while (start <= (int)list.length())
+    {
+      int end = list.indexOf(',', start);
+      if (end < 0)
+        end = list.length();
+      int16_t i = getIndex(list.substring(start, end).c_str());
+      if (i >= 0)
+        fields.set(i);
+      start = end + 1;
+    }
+    return true;
   }
+  return false;
 }
 
-//***********Different type for ESP32 WebServer and ESP8266WebServer ********
-// both classes have the same functions
-#if defined(ESP32)
-// function to respond a HTTP request for the form use the default file
-// to save and restart ESP after saving the new config
-void WebConfig::handleFormRequest(WebServer *server)
+// a byte of the part, only the bytes from skip on fit into the buffer
+void WebConfigWriter::write(char c)
 {
-  handleFormRequest(server, CONFFILE);
+  if ((_len >= _skip) && (_cnt < _maxLen))
+    _buffer[_cnt++] = c;
+  _len++;
 }
-// function to respond a HTTP request for the form use the filename
-// to save. If auto is true restart ESP after saving the new config
-void WebConfig::handleFormRequest(WebServer *server, const char *filename)
-{
-#else
-// function to respond a HTTP request for the form use the default file
-// to save and restart ESP after saving the new config
-void WebConfig::handleFormRequest(ESP8266WebServer *server)
+
+void WebConfigWriter::print(const char *text)
 {
-  handleFormRequest(server, CONFFILE);
+  if (text == nullptr)
+    return;
+  while (*text != 0)
+    write(*text++);
 }
-// function to respond a HTTP request for the form use the filename
-// to save. If auto is true restart ESP after saving the new config
-void WebConfig::handleFormRequest(ESP8266WebServer *server, const char *filename)
+
+void WebConfigWriter::print_P(const char *text)
 {
-#endif
-  //******************** Rest of the function has no difference ***************
-  bool saved = false;
-  bool errorSaving = false;
+  char c;
+  while ((c = pgm_read_byte(text++)) != 0)
+    write(c);
+}
 
-  uint8_t a, v;
-  String val;
-  if (server->args() > 0)
+// values are streamed from their strings, so no buffer limits their length
+void WebConfigWriter::printEscaped(const char *text)
+{
+  if (text == nullptr)
+    return;
+  for (; *text != 0; text++)
   {
-    if (server->hasArg(F("deviceName")))
-      _deviceNAme = server->arg(F("deviceName"));
+    switch (*text)
+    {
+    case '&':
+      print("&amp;");
+      break;
+    case '<':
+      print("&lt;");
+      break;
+    case '>':
+      print("&gt;");
+      break;
+    case '\'':
+      print("&#39;");
+      break;
+    case '"':
+      print("&quot;");
+      break;
+    default:
+      write(*text);
+    }
+  }
+}
 
-    for (uint8_t i = 0; i < Staticindex; i++)
+// letters, digits and - _ . ~ are kept, everything else is sent as %XX
+void WebConfigWriter::printEncoded(const char *text)
+{
+  if (text == nullptr)
+    return;
+  for (; *text != 0; text++)
+  {
+    uint8_t c = *text;
+    if (isalnum(c) || (c == '-') || (c == '_') || (c == '.') || (c == '~'))
     {
-      if (_description[i].type == INPUTCHECKBOX)
-      {
-        values[i] = "0";
-        if (server->hasArg(_description[i].name))
-          values[i] = "1";
-      }
-      else if (_description[i].type == INPUTMULTICHECK)
-      {
-        values[i] = "";
-        for (a = 0; a < _description[i].optionCnt; a++)
-          values[i] += "0"; // clear result
-        for (a = 0; a < server->args(); a++)
-        {
-          if (server->argName(a) == _description[i].name)
-          {
-            val = server->arg(a);
-            v = val.toInt();
-            values[i].setCharAt(v, '1');
-          }
-        }
-      }
-      else
-      {
-        if (server->hasArg(_description[i].name))
-          values[i] = server->arg(_description[i].name);
-      }
+      write(c);
     }
-    if (server->hasArg(F("SAVE")) || server->hasArg(F("RST")))
+    else
     {
-
-      saved = writeConfig();
-      errorSaving = !saved;
-      Serial.println(saved);
-      if (server->hasArg(F("RST")))
-      {
-        ESP.restart();
-      }
+      write('%');
+      write("0123456789ABCDEF"[c >> 4]);
+      write("0123456789ABCDEF"[c & 15]);
     }
   }
-  boolean exit = false;
-  if (server->hasArg(F("SAVE")) && _onSave)
+}
+
+// the template is copied up to a placeholder, the value of the
+// placeholder is streamed and the template continues after it, so no
+// part of the template depends on the length of a value
+void WebConfigWriter::printTemplate(const char *format, ...)
+{
+  char num[24];
+  char c;
+  va_list args;
+  va_start(args, format);
+  while ((c = pgm_read_byte(format++)) != 0)
   {
-    _onSave(getResults());
-  }
-  if (server->hasArg(F("SAVE")) && _onSaveJson)
+    if (c != '%')
+    {
+      write(c);
+      continue;
+    }
+    c = pgm_read_byte(format++);
+    if (c == 0)
+      break;
+    if (c == 's')
+    {
+      printEscaped(va_arg(args, const char *));
+    }
+    else if (c == 'i')
+    {
+      snprintf(num, sizeof(num), "%i", va_arg(args, int));
+      print(num);
+    }
+    else if ((c == 'l') && (pgm_read_byte(format) == 'u'))
+    {
+      format++;
+      snprintf(num, sizeof(num), "%lu", va_arg(args, unsigned long));
+      print(num);
+    }
+    else
+    {
+      if (c != '%')
+        write('%');
+      write(c);
+    }
+  }
+  va_end(args);
+}
+
+void createSimple(WebConfigWriter &out, const char *name, const char *label, const char *type, const char *value)
+{
+  out.printTemplate(HTML_ENTRY_SIMPLE, label, type, value, name);
+}
+
+void createTextarea(WebConfigWriter &out, const DESCRIPTION &descr, const char *value)
+{
+  // max = rows min = cols
+  out.printTemplate(HTML_ENTRY_AREA, descr.label, descr.max, descr.min, descr.name, value);
+}
+
+void createNumber(WebConfigWriter &out, const DESCRIPTION &descr, const char *value)
+{
+  out.printTemplate(HTML_ENTRY_NUMBER, descr.label, descr.min, descr.max, value, descr.name);
+}
+
+void createRange(WebConfigWriter &out, const DESCRIPTION &descr, const char *value)
+{
+  out.printTemplate(HTML_ENTRY_RANGE, descr.label, descr.min, descr.min, descr.max, value, descr.name, descr.max);
+}
+
+void createCheckbox(WebConfigWriter &out, const DESCRIPTION &descr, const char *value)
+{
+  if (strcmp(value, "0") != 0)
+  {
+    out.printTemplate(HTML_ENTRY_CHECKBOX, descr.label, "checked", descr.name);
+  }
+  else
+  {
+    out.printTemplate(HTML_ENTRY_CHECKBOX, descr.label, "", descr.name);
+  }
+}
+
+void createRadio(WebConfigWriter &out, const char *name, const char *option, const char *label, const char *value)
+{
+  if (strcmp(option, value) == 0)
+  {
+    out.printTemplate(HTML_ENTRY_RADIO, name, option, "checked", label);
+  }
+  else
+  {
+    out.printTemplate(HTML_ENTRY_RADIO, name, option, "", label);
+  }
+}
+
+void startSelect(WebConfigWriter &out, const DESCRIPTION &descr)
+{
+  out.printTemplate(HTML_ENTRY_SELECT_START, descr.label, descr.name);
+}
+
+void addSelectOption(WebConfigWriter &out, const char *option, const char *label, const char *value)
+{
+  if (strcmp(option, value) == 0)
+  {
+    out.printTemplate(HTML_ENTRY_SELECT_OPTION, option, "selected", label);
+  }
+  else
+  {
+    out.printTemplate(HTML_ENTRY_SELECT_OPTION, option, "", label);
+  }
+}
+
+void startMulti(WebConfigWriter &out, const DESCRIPTION &descr)
+{
+  out.printTemplate(HTML_ENTRY_MULTI_START, descr.label);
+}
+
+void addMultiOption(WebConfigWriter &out, const char *name, uint8_t option, const char *label, const char *value)
+{
+  if ((strlen(value) > option) && (value[option] == '1'))
+  {
+    out.printTemplate(HTML_ENTRY_MULTI_OPTION, name, option, "checked", label);
+  }
+  else
+  {
+    out.printTemplate(HTML_ENTRY_MULTI_OPTION, name, option, "", label);
+  }
+}
+
+#if defined(WEBCONFIG_WEBSERVER)
+// function to respond a HTTP request for the form use the default file
+// to save and restart ESP after saving the new config
+void WebConfig::handleFormRequest(WebServer *server)
+{
+  handleFormRequest(server, CONFFILE);
+}
+// function to respond a HTTP request for the form use the filename
+// to save. If auto is true restart ESP after saving the new config
+void WebConfig::handleFormRequest(WebServer *server, const char *filename)
+{
+  // the transport is kept because a sliced response outlives the handler
+  if ((_serverTransport == nullptr) || (_serverTransport->getServer() != server))
+  {
+    delete _serverTransport;
+    _serverTransport = new WebServerTransport(server);
+  }
+  _serverTransport->setSlice(_renderSlice);
+  handleFormRequest(_serverTransport);
+}
+#endif
+
+static void sendText(WebConfigTransport *server, const char *contentType, const String &text, int code = 200);
+
+// list the form at uri on the index page, title defaults to uri
+void WebConfig::mount(const char *uri, const char *title)
+{
+  _uri = uri;
+  if (title != nullptr)
+    _title = title;
+  lock();
+  WebConfig **p = &_instances;
+  while ((*p != nullptr) && (*p != this))
+    p = &(*p)->_nextInstance;
+  *p = this;
+  unlock();
+}
+
+// part of the index page, the start with the styles, one link per
+// mounted form and the end. Returns false after the end
+boolean WebConfig::indexPart(WebConfigWriter &out, uint16_t part)
+{
+  if (part == 0)
+  {
+    // the index has no form, only the styles are used
+    out.printTemplate(HTML_START, (_instances != nullptr) ? _instances->getDeviceName() : "");
+    return true;
+  }
+  uint16_t i = 1;
+  WebConfig *w = _instances;
+  for (; (w != nullptr) && (i < part); i++)
+    w = w->_nextInstance;
+  if (i < part)
+    return false;
+  if (w != nullptr)
+    out.printTemplate(HTML_INDEX_ENTRY, w->_uri.c_str(), (w->_title.length() > 0) ? w->_title.c_str() : w->_uri.c_str());
+  else
+    out.print("</div></body></html>\n");
+  return true;
+}
+
+// index page with a link to every mounted form, it is streamed like the
+// form, a part which does not fit is continued with the next chunk
+void WebConfig::handleIndex(WebConfigTransport *server)
+{
+  std::shared_ptr<RENDERSTATE> state = std::make_shared<RENDERSTATE>();
+  state->step = 0;
+  state->pos = 0;
+  server->send(200, "text/html", [state](uint8_t *buffer, size_t maxLen) -> size_t
+               {
+                 size_t cnt = 0;
+                 lock();
+                 while (cnt < maxLen)
+                 {
+                   WebConfigWriter out(buffer + cnt, maxLen - cnt, state->pos);
+                   if (!indexPart(out, state->step))
+                     break;
+                   state->pos += out.count();
+                   cnt += out.count();
+                   if (state->pos >= out.length())
+                   {
+                     state->step++;
+                     state->pos = 0;
+                   }
+                 }
+                 unlock();
+                 return cnt; });
+}
+
+// function to respond a form request received by any transport
+void WebConfig::handleFormRequest(WebConfigTransport *server)
+{
+  bool saved = false;
+  bool errorSaving = false;
+
+  uint8_t a;
+  long v;
+  uint8_t invalid = 0;
+  String val;
+  // requests of the client side rendering
+  String api = server->arg(F("wc"));
+  if (api == "schema")
+  {
+    sendSchema(server);
+    return;
+  }
+  if (api == "values")
+  {
+    sendValues(server, false, false, 0);
+    return;
+  }
+  if (api == "options")
+  {
+    sendOptions(server, server->arg(F("f")).toInt());
+    return;
+  }
+  if (api == "changes")
+  {
+    lock();
+    String json = getChangesJson(strtoul(server->arg(F("since")).c_str(), nullptr, 10),
+                              strtoul(server->arg(F("epoch")).c_str(), nullptr, 10));
+    unlock();
+    server->sendHeader("Cache-Control", "no-cache");
+    sendText(server, "application/json", json);
+    return;
+  }
+  if (api == "events")
+  {
+    openEvents(server);
+    return;
+  }
+  if (api == "apply")
+  {
+    applyChanges(server);
+    return;
+  }
+  if (api == "export")
+  {
+    // the backup is streamed from the values, hash=0 omits the schema hash
+    std::shared_ptr<EXPORTSTATE> state = std::make_shared<EXPORTSTATE>();
+    beginExport(*state, server->arg(F("hash")) != "0");
+    server->sendHeader("Content-Disposition", "attachment; filename=\"config.wcb\"");
+    server->sendHeader("Cache-Control", "no-cache");
+    server->send(200, "text/plain", [this, state](uint8_t *buffer, size_t maxLen) -> size_t
+                 {
+                   lock();
+                   size_t n = exportChunk(*state, buffer, maxLen);
+                   unlock();
+                   return n; });
+    return;
+  }
+  if (api == "import")
+  {
+    restoreConfig(server);
+    return;
+  }
+  // a profile switch changes the stored config, a link must not do it
+  if ((api == "profile") && !server->isPost())
+  {
+    sendText(server, "text/plain", "POST required", 405);
+    return;
+  }
+  lock();
+  // a section or a field list renders and updates only these fields
+  WebConfigChanges selected;
+  uint8_t section;
+  boolean partial = selectFields(server, selected, section);
+  uint8_t buttons = 0;
+  boolean posted = false;
+  uint32_t allocs = allocations();
+  // the unparsed body of the shell, the async adapter has already
+  // decoded it while it was received
+  WebConfigFormState *form = (api == "submit") ? server->takeForm() : nullptr;
+  if ((form != nullptr) || ((api == "submit") && server->hasArg(F("plain"))))
+  {
+    // WebServer holds the body as argument plain, it is decoded in place
+    if (form == nullptr)
+    {
+      form = beginForm(server);
+      server->readBody([this, form](const uint8_t *data, size_t len)
+                       { formChunk(form, data, len); });
+    }
+    invalid = endForm(form, buttons);
+    posted = true;
+  }
+  else if (api == "profile")
+  {
+    // a profile button switches the values and shows the form again
+    selectProfile(server->arg(F("name")).c_str());
+  }
+  else if ((api.length() == 0) && (server->args() > (partial ? 1 : 0)))
+  {
+    if (server->hasArg(F("deviceName")))
+    {
+      String name = server->arg(F("deviceName"));
+      // the same limit as for a name posted as body
+      if (name.length() >= WEBCONFIG_MAXLENGTH)
+      {
+        invalid++;
+      }
+      else if (name != _deviceNAme)
+      {
+        _deviceNAme = std::move(name);
+        _nameVersion = ++_version;
+        markDirty();
+      }
+    }
+
+    for (uint8_t i = 0; i < Staticindex; i++)
+    {
+      if (partial && !selected.contains(i))
+        continue;
+      uint8_t post = typeOf(_description[i].type)->post;
+      if (post == POST_CHECKED)
+      {
+        updateValue(i, server->hasArg(_description[i].name) ? "1" : "0");
+      }
+      else if (post == POST_INDICES)
+      {
+        val = "";
+        for (a = 0; a < _description[i].optionCnt; a++)
+          val += "0"; // clear result
+        for (a = 0; a < server->args(); a++)
+        {
+          if (server->argName(a) == _description[i].name)
+          {
+            // only indices of existing options are accepted
+            if (parseInteger(server->arg(a).c_str(), v) && (v >= 0) && (v < _description[i].optionCnt))
+              val.setCharAt(v, '1');
+            else
+              invalid++;
+          }
+        }
+        updateValue(i, val);
+      }
+      else
+      {
+        // the temporary returned by arg() is moved into the value
+        if (server->hasArg(_description[i].name) && !updateValue(i, server->arg(_description[i].name)))
+          invalid++;
+      }
+    }
+    buttons = pressedButtons(server);
+    posted = true;
+  }
+  if (posted && (buttons & (BTN_SAVE | BTN_RST)))
+  {
+    // in write-behind mode the commit is done later by loop()
+    // nothing to write if the form did not change anything
+    saved = _dirty ? writeConfig() : true;
+    errorSaving = !saved;
+    Serial.println(saved);
+    if (buttons & BTN_RST)
+    {
+      flush();
+#if defined(WEBCONFIG_WEBSERVER)
+      ESP.restart();
+#endif
+    }
+  }
+  if (posted)
+    _saveAllocs = allocations() - allocs;
+  boolean exit = false;
+  if ((buttons & BTN_SAVE) && _onSave)
+  {
+    _onSave(getResults());
+  }
+  if ((buttons & BTN_SAVE) && _onSaveJson)
+  {
+    _onSaveJson(getResultsJson());
+  }
+  if ((buttons & BTN_SAVE) && _onSave_null)
+  {
+    _onSave_null();
+  }
+  if (buttons & BTN_SAVE)
+  {
+    dispatchChanges();
+  }
+  if ((buttons & BTN_DONE) && _onDone)
+  {
+    _onDone(getResults());
+    exit = true;
+  }
+  if ((buttons & BTN_CANCEL) && _onCancel)
+  {
+    _onCancel();
+    exit = true;
+  }
+  if ((buttons & BTN_DELETE) && _onDelete)
+  {
+    _onDelete(_deviceNAme);
+    exit = true;
+  }
+  unlock();
+  if (exit)
+    return;
+  if (api == "submit")
+  {
+    sendValues(server, saved, errorSaving, invalid);
+  }
+  else if (_clientRendering)
+  {
+    sendShell(server);
+  }
+  else
+  {
+    // every response has its own render state, the transport pulls the
+    // form in chunks as fast as it can send them
+    std::shared_ptr<RENDERSTATE> state = std::make_shared<RENDERSTATE>();
+    beginRender(*state, saved, errorSaving);
+    state->invalid = invalid;
+    state->partial = partial;
+    state->section = section;
+    state->fields = selected;
+    server->send(200, "text/html", [this, state](uint8_t *buffer, size_t maxLen) -> size_t
+                 {
+                   lock();
+                   size_t n = renderChunk(*state, buffer, maxLen);
+                   unlock();
+                   return n; });
+  }
+}
+
+// send a string in chunks, the string is kept until the response is complete
+static void sendText(WebConfigTransport *server, const char *contentType, const String &text, int code)
+{
+  std::shared_ptr<String> body = std::make_shared<String>(text);
+  std::shared_ptr<size_t> pos = std::make_shared<size_t>(0);
+  server->send(code, contentType, [body, pos](uint8_t *buffer, size_t maxLen) -> size_t
+               {
+                 size_t n = body->length() - *pos;
+                 if (n > maxLen)
+                   n = maxLen;
+                 memcpy(buffer, body->c_str() + *pos, n);
+                 *pos += n;
+                 return n; });
+}
+
+// append s as JSON string to out
+static void jsonString(String &out, const char *s)
+{
+  char hex[8];
+  out += '"';
+  for (; *s != 0; s++)
+  {
+    if ((*s == '"') || (*s == '\\'))
+    {
+      out += '\\';
+      out += *s;
+    }
+    else if ((uint8_t)*s < 0x20)
+    {
+      snprintf(hex, sizeof(hex), "\\u%04x", (uint8_t)*s);
+      out += hex;
+    }
+    else
+    {
+      out += *s;
+    }
+  }
+  out += '"';
+}
+
+// build the form in the browser
+void WebConfig::setClientRendering(boolean enable)
+{
+  _clientRendering = enable;
+}
+
+// add a script to the HTML form which applies changes pushed by the device
+void WebConfig::setLiveUpdate(boolean enable)
+{
+  _liveUpdate = enable;
+}
+
+// the descriptions have been modified, cached schemas are outdated
+void WebConfig::touchSchema()
+{
+  _schemaHash = (_schemaHash ^ 0x5a) * 16777619UL;
+}
+
+// static page of the client side rendering, it may be cached by the browser
+void WebConfig::sendShell(WebConfigTransport *server)
+{
+  std::shared_ptr<size_t> pos = std::make_shared<size_t>(0);
+  server->sendHeader("Cache-Control", "max-age=86400");
+  server->send(200, "text/html", [pos](uint8_t *buffer, size_t maxLen) -> size_t
+               {
+                 size_t n = strlen_P(HTML_SHELL) - *pos;
+                 if (n > maxLen)
+                   n = maxLen;
+                 memcpy_P(buffer, HTML_SHELL + *pos, n);
+                 *pos += n;
+                 return n; });
+}
+
+// the descriptions as JSON. A request with the current hash may be cached
+// forever, a changed schema gets a new hash
+void WebConfig::sendSchema(WebConfigTransport *server)
+{
+  String json;
+  lock();
+  size_t capacity = JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(Staticindex);
+  for (uint8_t i = 0; i < Staticindex; i++)
+    capacity += JSON_OBJECT_SIZE(9) + JSON_ARRAY_SIZE(_description[i].optionCnt) +
+                _description[i].optionCnt * JSON_ARRAY_SIZE(2);
+  DynamicJsonDocument doc(capacity);
+  doc["h"] = _schemaHash;
+  doc["b"] = _buttons;
+  JsonArray fields = doc.createNestedArray("f");
+  for (uint8_t i = 0; i < Staticindex; i++)
+  {
+    // strings are referenced and not copied into the document
+    const DESCRIPTION &d = _description[i];
+    JsonObject f = fields.createNestedObject();
+    f["n"] = (const char *)d.name;
+    f["l"] = (const char *)d.label;
+    f["t"] = d.type;
+    f["y"] = typeOf(d.type)->input;
+    f["i"] = d.min;
+    f["a"] = d.max;
+    f["m"] = d.maxLength;
+    if (d.section > 0)
+      f["s"] = (const char *)_sections[d.section - 1];
+    if (providerOf(i) != nullptr)
+    {
+      f["p"] = 1;
+    }
+    else if (d.optionCnt > 0)
+    {
+      JsonArray o = f.createNestedArray("o");
+      for (uint8_t j = 0; j < d.optionCnt; j++)
+      {
+        JsonArray opt = o.createNestedArray();
+        opt.add(d.options->option(j));
+        opt.add(d.options->label(j));
+      }
+    }
+  }
+  serializeJson(doc, json);
+  boolean current = server->arg(F("h")) == String(_schemaHash);
+  unlock();
+  server->sendHeader("Cache-Control", current ? "max-age=31536000" : "no-cache");
+  sendText(server, "application/json", json);
+}
+
+// the current values as JSON together with the result of a submit
+void WebConfig::sendValues(WebConfigTransport *server, boolean saved, boolean errorSaving, uint8_t invalid)
+{
+  String json;
+  lock();
+  DynamicJsonDocument doc(JSON_OBJECT_SIZE(8) + JSON_OBJECT_SIZE(MAXVALUES));
+  doc["h"] = _schemaHash;
+  doc["d"] = _deviceNAme.c_str();
+  doc["s"] = saved;
+  doc["e"] = errorSaving;
+  doc["i"] = invalid;
+  doc["ver"] = _version;
+  doc["epoch"] = _epoch;
+  JsonObject v = doc.createNestedObject("v");
+  for (uint8_t i = 0; i < Staticindex; i++)
+    v[(const char *)_description[i].name] = valueOf(i);
+  serializeJson(doc, json);
+  unlock();
+  server->sendHeader("Cache-Control", "no-cache");
+  sendText(server, "application/json", json);
+}
+
+// the fields changed since version as JSON. The epoch of a former run
+// or an unknown version deliver all fields
+String WebConfig::getChangesJson(uint32_t since, uint32_t epoch)
+{
+  String json;
+  if ((epoch != _epoch) || (since > _version))
+    since = 0;
+  DynamicJsonDocument doc(JSON_OBJECT_SIZE(5) + JSON_OBJECT_SIZE(MAXVALUES));
+  doc["h"] = _schemaHash;
+  doc["ver"] = _version;
+  doc["epoch"] = _epoch;
+  if ((since == 0) || (_nameVersion > since))
+    doc["d"] = _deviceNAme.c_str();
+  JsonObject v = doc.createNestedObject("v");
+  for (uint8_t i = 0; i < Staticindex; i++)
+  {
+    if ((since == 0) || (_fieldVersion[i] > since))
+      v[(const char *)_description[i].name] = valueOf(i);
+  }
+  serializeJson(doc, json);
+  return json;
+}
+
+// apply a batch of changes posted as name=value arguments together with
+// the base version and epoch the client knows. The batch is rejected
+// with 409 if one of its fields was changed after the base version and
+// with 422 if a field is unknown or a value is invalid. Nothing is
+// changed then. The response holds the fields changed since base
+void WebConfig::applyChanges(WebConfigTransport *server)
+{
+  uint32_t base = strtoul(server->arg(F("base")).c_str(), nullptr, 10);
+  uint32_t epoch = strtoul(server->arg(F("epoch")).c_str(), nullptr, 10);
+  String vals[MAXVALUES];
+  WebConfigChanges batch;
+  String name;
+  boolean hasName = false;
+  String invalid;
+  int code = 200;
+  lock();
+  boolean conflict = (epoch != _epoch) || (base > _version);
+  for (int a = 0; a < server->args(); a++)
+  {
+    String n = server->argName(a);
+    if ((n == "wc") || (n == "base") || (n == "epoch"))
+      continue;
+    if (n == "deviceName")
+    {
+      conflict |= (_nameVersion > base);
+      name = server->arg(a);
+      hasName = true;
+      if (name.length() >= WEBCONFIG_MAXLENGTH)
+        invalid += (invalid.length() > 0) ? "," + n : n;
+      continue;
+    }
+    int16_t i = getIndex(n.c_str());
+    if (i >= 0)
+    {
+      conflict |= (_fieldVersion[i] > base);
+      vals[i] = server->arg(a);
+      batch.set(i);
+    }
+    if ((i < 0) || !validateValue(i, vals[i]))
+      invalid += (invalid.length() > 0) ? "," + n : n;
+  }
+  if (conflict)
+  {
+    code = 409;
+  }
+  else if (invalid.length() > 0)
+  {
+    code = 422;
+  }
+  else
+  {
+    for (uint8_t i = 0; i < Staticindex; i++)
+    {
+      if (batch.contains(i))
+        updateValue(i, vals[i]);
+    }
+    if (hasName && (name != _deviceNAme))
+    {
+      _deviceNAme = name;
+      _nameVersion = ++_version;
+      markDirty();
+    }
+    if (_dirty && !writeConfig())
+      code = 500;
+    dispatchChanges();
+  }
+  String json = getChangesJson(base, epoch);
+  unlock();
+  if (code == 422)
+  {
+    json = "{\"invalid\":";
+    jsonString(json, invalid.c_str());
+    json += '}';
+  }
+  server->sendHeader("Cache-Control", "no-cache");
+  sendText(server, "application/json", json, code);
+}
+
+//*************************** backup and restore *****************************
+// The backup is a text blob with one line per value, so it survives the
+// WebServer argument handling which stops at a zero byte:
+// #WCB1 <schema hash hex, 0 = any schema>
+// deviceName=<value>
+// <name>=<value>
+// #END
+// Control characters, % and DEL in values are escaped as %XX
+
+// writer for one line of the backup, only the bytes from skip on are
+// copied into buf, total counts the bytes of the whole line
+struct EXPORTWRITER
+{
+  uint8_t *buf;
+  size_t maxLen;
+  size_t skip;
+  size_t total;
+  size_t cnt;
+};
+
+static void exportPut(EXPORTWRITER &w, char c)
+{
+  if ((w.total >= w.skip) && (w.cnt < w.maxLen))
+    w.buf[w.cnt++] = c;
+  w.total++;
+}
+
+static void exportPut(EXPORTWRITER &w, const char *s, boolean escape)
+{
+  for (; *s != 0; s++)
+  {
+    uint8_t c = *s;
+    if (escape && ((c < 0x20) || (c == '%') || (c == 0x7f)))
+    {
+      exportPut(w, '%');
+      exportPut(w, "0123456789ABCDEF"[c >> 4]);
+      exportPut(w, "0123456789ABCDEF"[c & 15]);
+    }
+    else
+    {
+      exportPut(w, (char)c);
+    }
+  }
+}
+
+void WebConfig::beginExport(boolean withHash)
+{
+  beginExport(_export, withHash);
+}
+
+void WebConfig::beginExport(EXPORTSTATE &state, boolean withHash)
+{
+  state.item = 0;
+  state.pos = 0;
+  state.withHash = withHash;
+}
+
+// write line item of the backup, false after the last line
+boolean WebConfig::exportItem(EXPORTWRITER &w, uint8_t item, boolean withHash)
+{
+  char tmp[20];
+  if (item == 0)
+  {
+    snprintf(tmp, sizeof(tmp), "#WCB1 %08lx\n", withHash ? (unsigned long)_schemaHash : 0UL);
+    exportPut(w, tmp, false);
+  }
+  else if (item == 1)
+  {
+    exportPut(w, "deviceName=", false);
+    exportPut(w, _deviceNAme.c_str(), true);
+    exportPut(w, '\n');
+  }
+  else if (item < Staticindex + 2)
+  {
+    exportPut(w, _description[item - 2].name, false);
+    exportPut(w, '=');
+    exportPut(w, valueOf(item - 2), true);
+    exportPut(w, '\n');
+  }
+  else if (item == Staticindex + 2)
+  {
+    exportPut(w, "#END\n", false);
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+size_t WebConfig::exportChunk(uint8_t *buffer, size_t maxLen)
+{
+  return exportChunk(_export, buffer, maxLen);
+}
+
+// copy the next part of the backup into buffer. A line which does not
+// fit is continued at state.pos with the next call
+size_t WebConfig::exportChunk(EXPORTSTATE &state, uint8_t *buffer, size_t maxLen)
+{
+  size_t cnt = 0;
+  while (cnt < maxLen)
+  {
+    EXPORTWRITER w = {buffer + cnt, maxLen - cnt, state.pos, 0, 0};
+    if (!exportItem(w, state.item, state.withHash))
+      break;
+    cnt += w.cnt;
+    if (w.total > state.pos + w.cnt)
+    {
+      state.pos += w.cnt;
+      break;
+    }
+    state.item++;
+    state.pos = 0;
+  }
+  return cnt;
+}
+
+enum
+{
+  IMPORT_NAME,
+  IMPORT_VALUE,
+  IMPORT_COMMENT
+};
+
+// decoder of a restore, the values are applied by endImport()
+struct WebConfigImportState
+{
+  uint8_t mode;
+  char line[NAMELENGTH + 12];
+  uint8_t lineLen;
+  int16_t index;
+  uint8_t hex;
+  uint8_t hexCnt;
+  boolean header;
+  boolean complete;
+  boolean error;
+  uint32_t hash;
+  String deviceName;
+  boolean hasName;
+  WebConfigChanges present;
+  // restored values, after they are applied the old values to revert
+  // them if the commit fails
+  String values[MAXVALUES];
+  uint32_t versions[MAXVALUES];
+};
+
+// start a restore, every restore has its own state
+WebConfigImportState *WebConfig::beginImport()
+{
+  WebConfigImportState *s = new WebConfigImportState;
+  s->mode = IMPORT_NAME;
+  s->lineLen = 0;
+  s->header = false;
+  s->complete = false;
+  s->error = false;
+  s->hash = 0;
+  s->hasName = false;
+  return s;
+}
+
+// free a restore which is not applied
+void WebConfig::discardImport(WebConfigImportState *state)
+{
+  delete state;
+}
+
+// a comment line, the first one has to be the header
+void WebConfig::importLine(WebConfigImportState *s)
+{
+  s->line[s->lineLen] = 0;
+  if (!s->header)
+  {
+    s->header = strncmp(s->line, "WCB1 ", 5) == 0;
+    s->hash = strtoul(s->line + 5, nullptr, 16);
+    s->error = !s->header;
+  }
+  else if (strcmp(s->line, "END") == 0)
+  {
+    s->complete = true;
+  }
+}
+
+// decode the next part of a backup, the values are kept until endImport()
+// returns false if the data is not a backup
+boolean WebConfig::importChunk(WebConfigImportState *s, const uint8_t *data, size_t len)
+{
+  if (s == nullptr)
+    return false;
+  // the fields are looked up while decoding
+  lock();
+  for (size_t i = 0; (i < len) && !s->error && !s->complete; i++)
+  {
+    char c = data[i];
+    switch (s->mode)
+    {
+    case IMPORT_NAME:
+      if ((c == '#') && (s->lineLen == 0))
+      {
+        s->mode = IMPORT_COMMENT;
+      }
+      else if (c == '\n')
+      {
+        // only empty lines are allowed without value
+        s->error = s->lineLen > 0;
+      }
+      else if (c == '=')
+      {
+        s->line[s->lineLen] = 0;
+        s->error = !s->header;
+        // fields unknown to this schema are skipped
+        s->index = (strcmp(s->line, "deviceName") == 0) ? -2 : getIndex(s->line);
+        if (s->index >= 0)
+        {
+          s->values[s->index] = "";
+          s->present.set(s->index);
+        }
+        else if (s->index == -2)
+        {
+          s->deviceName = "";
+          s->hasName = true;
+        }
+        s->hexCnt = 0;
+        s->mode = IMPORT_VALUE;
+      }
+      else if (s->lineLen < sizeof(s->line) - 1)
+      {
+        s->line[s->lineLen++] = c;
+      }
+      break;
+    case IMPORT_COMMENT:
+      if (c == '\n')
+      {
+        importLine(s);
+        s->lineLen = 0;
+        s->mode = IMPORT_NAME;
+      }
+      else if (s->lineLen < sizeof(s->line) - 1)
+      {
+        s->line[s->lineLen++] = c;
+      }
+      break;
+    case IMPORT_VALUE:
+      if (c == '\n')
+      {
+        s->error = s->hexCnt > 0;
+        s->lineLen = 0;
+        s->mode = IMPORT_NAME;
+        break;
+      }
+      if (s->hexCnt > 0)
+      {
+        if (!isxdigit(c))
+        {
+          s->error = true;
+          break;
+        }
+        s->hex = (s->hex << 4) | (isdigit(c) ? c - '0' : (toupper(c) - 'A' + 10));
+        if (--s->hexCnt > 0)
+          break;
+        c = s->hex;
+      }
+      else if (c == '%')
+      {
+        s->hexCnt = 2;
+        s->hex = 0;
+        break;
+      }
+      // a value is never buffered beyond the limit of its field
+      if (s->index >= 0)
+      {
+        if (s->values[s->index].length() < _description[s->index].maxLength)
+          s->values[s->index] += c;
+        else
+          s->error = true;
+      }
+      else if (s->index == -2)
+      {
+        if (s->deviceName.length() < WEBCONFIG_MAXLENGTH)
+          s->deviceName += c;
+        else
+          s->error = true;
+      }
+      if (s->error)
+        Serial.printf("Value for %s too long in restore\n", s->line);
+      break;
+    }
+  }
+  unlock();
+  return !s->error;
+}
+
+// apply a complete restore with one commit, all values are validated first
+boolean WebConfig::endImport(WebConfigImportState *s)
+{
+  if (s == nullptr)
+    return false;
+  lock();
+  boolean ok = !s->error && s->complete && ((s->hash == 0) || (s->hash == _schemaHash));
+  for (uint8_t i = 0; ok && (i < Staticindex); i++)
+  {
+    if (s->present.contains(i) && !validateValue(i, s->values[i]))
+    {
+      Serial.printf("Invalid value for %s in restore\n", _description[i].name);
+      ok = false;
+    }
+  }
+  if (ok)
+  {
+    // the old state is kept in s, a failed commit reverts the restore
+    WebConfigChanges changes = _changes;
+    WebConfigChanges overridden = _overridden;
+    uint32_t version = _version;
+    uint32_t nameVersion = _nameVersion;
+    for (uint8_t i = 0; i < Staticindex; i++)
+    {
+      if (s->present.contains(i))
+      {
+        String val = std::move(s->values[i]);
+        s->values[i] = values[i];
+        s->versions[i] = _fieldVersion[i];
+        updateValue(i, std::move(val));
+      }
+    }
+    if (s->hasName && (s->deviceName != _deviceNAme))
+    {
+      std::swap(_deviceNAme, s->deviceName);
+      _nameVersion = ++_version;
+      markDirty();
+    }
+    else
+    {
+      s->hasName = false;
+    }
+    // one commit for the whole restore, also in write-behind mode
+    ok = !_dirty || flush();
+    if (!ok)
+    {
+      for (uint8_t i = 0; i < Staticindex; i++)
+      {
+        if (s->present.contains(i))
+        {
+          values[i] = std::move(s->values[i]);
+          _fieldVersion[i] = s->versions[i];
+        }
+      }
+      if (s->hasName)
+        _deviceNAme = std::move(s->deviceName);
+      _changes = changes;
+      _overridden = overridden;
+      _version = version;
+      _nameVersion = nameVersion;
+      // the storage may hold a part of the restore, the old values are
+      // written again
+      markDirty();
+    }
+    dispatchChanges();
+  }
+  unlock();
+  if (!ok)
+    Serial.println(F("Restore rejected"));
+  delete s;
+  return ok;
+}
+
+// restore request. WebServer passes the body as argument plain, the async
+// adapter feeds it to importChunk() while it is received
+void WebConfig::restoreConfig(WebConfigTransport *server)
+{
+  WebConfigImportState *state = server->takeImport();
+  if ((state == nullptr) && server->hasArg(F("plain")))
+  {
+    // WebServer holds the body as argument plain, it is decoded in place
+    state = beginImport();
+    server->readBody([this, state](const uint8_t *data, size_t len)
+                     { importChunk(state, data, len); });
+  }
+  boolean ok = endImport(state);
+  sendText(server, "text/plain", ok ? "RESTORED" : "RESTORE REJECTED", ok ? 200 : 422);
+}
+
+//************************** form decoder ************************************
+// a urlencoded body is decoded while it is received. Only the name and
+// the value of the current field are held, a complete value is validated
+// and moved into its slot
+
+// special fields of a form
+#define FORM_SKIP -1
+#define FORM_DEVICENAME -2
+#define FORM_BUTTON -3
+
+enum
+{
+  FORM_NAME,
+  FORM_VALUE
+};
+
+// decoder of a form body, a value is only held until it is stored
+struct WebConfigFormState
+{
+  uint8_t mode;
+  char name[NAMELENGTH];
+  uint8_t nameLen;
+  int16_t index;
+  uint8_t hex;
+  uint8_t hexCnt;
+  // name or value too long
+  boolean overflow;
+  uint8_t buttons;
+  uint8_t invalid;
+  boolean partial;
+  WebConfigChanges selected;
+  // checkboxes and multi checkboxes sent, they are set by endForm()
+  WebConfigChanges present;
+  uint16_t checked[MAXVALUES];
+  String value;
+};
+
+// buttons pressed in a form request
+uint8_t WebConfig::pressedButtons(WebConfigTransport *server)
+{
+  uint8_t buttons = 0;
+  if (server->hasArg(F("SAVE")))
+    buttons |= BTN_SAVE;
+  if (server->hasArg(F("RST")))
+    buttons |= BTN_RST;
+  if (server->hasArg(F("DONE")))
+    buttons |= BTN_DONE;
+  if (server->hasArg(F("CANCEL")))
+    buttons |= BTN_CANCEL;
+  if (server->hasArg(F("DELETE")))
+    buttons |= BTN_DELETE;
+  return buttons;
+}
+
+// start decoding a form body, every body has its own state
+WebConfigFormState *WebConfig::beginForm(WebConfigTransport *server)
+{
+  uint8_t section;
+  WebConfigFormState *s = new WebConfigFormState;
+  s->mode = FORM_NAME;
+  s->nameLen = 0;
+  s->overflow = false;
+  s->buttons = 0;
+  s->invalid = 0;
+  lock();
+  s->partial = (server != nullptr) && selectFields(server, s->selected, section);
+  unlock();
+  memset(s->checked, 0, sizeof(s->checked));
+  return s;
+}
+
+// free a form body which was not finished
+void WebConfig::discardForm(WebConfigFormState *state)
+{
+  delete state;
+}
+
+// the name of the current field is complete
+void WebConfig::formName(WebConfigFormState *s)
+{
+  s->name[s->nameLen] = 0;
+  if (s->overflow)
+    s->index = FORM_SKIP;
+  else if (strcmp(s->name, "deviceName") == 0)
+    s->index = FORM_DEVICENAME;
+  else if ((strcmp(s->name, "SAVE") == 0) || (strcmp(s->name, "RST") == 0) || (strcmp(s->name, "DONE") == 0) ||
+           (strcmp(s->name, "CANCEL") == 0) || (strcmp(s->name, "DELETE") == 0))
+    s->index = FORM_BUTTON;
+  else
+    s->index = getIndex(s->name);
+  s->overflow = false;
+  s->hexCnt = 0;
+  s->mode = FORM_VALUE;
+}
+
+// the value of the current field is complete
+void WebConfig::formField(WebConfigFormState *s)
+{
+  long v;
+  int16_t i = s->index;
+  if ((i >= 0) && s->partial && !s->selected.contains(i))
+    i = FORM_SKIP;
+  if (s->overflow && (i != FORM_SKIP))
+  {
+    Serial.printf("Value for %s too long\n", s->name);
+    s->invalid++;
+  }
+  else if (i == FORM_DEVICENAME)
+  {
+    if (s->value != _deviceNAme)
+    {
+      _deviceNAme = std::move(s->value);
+      _nameVersion = ++_version;
+      markDirty();
+    }
+  }
+  else if (i == FORM_BUTTON)
+  {
+    if (strcmp(s->name, "SAVE") == 0)
+      s->buttons |= BTN_SAVE;
+    else if (strcmp(s->name, "RST") == 0)
+      s->buttons |= BTN_RST;
+    else if (strcmp(s->name, "DONE") == 0)
+      s->buttons |= BTN_DONE;
+    else if (strcmp(s->name, "CANCEL") == 0)
+      s->buttons |= BTN_CANCEL;
+    else
+      s->buttons |= BTN_DELETE;
+  }
+  else if (i >= 0)
+  {
+    switch (typeOf(_description[i].type)->post)
+    {
+    case POST_CHECKED:
+      s->present.set(i);
+      break;
+    case POST_INDICES:
+      // only indices of existing options are accepted
+      s->present.set(i);
+      if (parseInteger(s->value.c_str(), v) && (v >= 0) && (v < _description[i].optionCnt))
+        s->checked[i] |= 1 << v;
+      else
+        s->invalid++;
+      break;
+    default:
+      if (!updateValue(i, std::move(s->value)))
+        s->invalid++;
+    }
+  }
+  s->value = String();
+}
+
+// decode the next part of a form body, the fields are stored as soon as
+// they are complete. Returns false if decoding was not started
+boolean WebConfig::formChunk(WebConfigFormState *s, const uint8_t *data, size_t len)
+{
+  // decoded characters are appended in runs to avoid a reallocation per character
+  char run[32];
+  uint8_t runLen = 0;
+  if (s == nullptr)
+    return false;
+  lock();
+  for (size_t i = 0; i <= len; i++)
+  {
+    char c = (i < len) ? data[i] : 0;
+    // flush the run at the end of the chunk, the value or when it is full
+    if ((runLen > 0) && ((i == len) || (c == '&') || (runLen == sizeof(run))))
+    {
+      if (s->value.length() + runLen > _description[s->index].maxLength)
+        s->overflow = true;
+      else
+        s->value.concat(run, runLen);
+      runLen = 0;
+    }
+    if (i == len)
+      break;
+    if (c == '&')
+    {
+      // a name without = is a field with empty value
+      if ((s->mode == FORM_NAME) && (s->nameLen > 0))
+        formName(s);
+      if (s->mode == FORM_VALUE)
+        formField(s);
+      s->mode = FORM_NAME;
+      s->nameLen = 0;
+      s->overflow = false;
+      continue;
+    }
+    if (s->mode == FORM_NAME)
+    {
+      if (c == '=')
+        formName(s);
+      else if (s->nameLen < sizeof(s->name) - 1)
+        s->name[s->nameLen++] = c;
+      else
+        s->overflow = true;
+      continue;
+    }
+    // the values of unknown fields and buttons are skipped
+    if ((s->index < 0) && (s->index != FORM_DEVICENAME))
+      continue;
+    if (s->hexCnt > 0)
+    {
+      if (!isxdigit(c))
+      {
+        s->hexCnt = 0;
+        continue;
+      }
+      s->hex = (s->hex << 4) | (isdigit(c) ? c - '0' : (toupper(c) - 'A' + 10));
+      if (--s->hexCnt > 0)
+        continue;
+      c = s->hex;
+    }
+    else if (c == '%')
+    {
+      s->hexCnt = 2;
+      s->hex = 0;
+      continue;
+    }
+    else if (c == '+')
+    {
+      c = ' ';
+    }
+    if (s->index == FORM_DEVICENAME)
+    {
+      if (s->value.length() < WEBCONFIG_MAXLENGTH)
+        s->value += c;
+      else
+        s->overflow = true;
+    }
+    else if (!s->overflow)
+      run[runLen++] = c;
+  }
+  unlock();
+  return true;
+}
+
+// finish a form body and set the checkboxes
+uint8_t WebConfig::endForm(WebConfigFormState *s, uint8_t &buttons)
+{
+  buttons = 0;
+  if (s == nullptr)
+    return 0;
+  lock();
+  // the last field is not terminated by &
+  if ((s->mode == FORM_NAME) && (s->nameLen > 0))
+    formName(s);
+  if (s->mode == FORM_VALUE)
+    formField(s);
+  for (uint8_t i = 0; i < Staticindex; i++)
+  {
+    if (s->partial && !s->selected.contains(i))
+      continue;
+    uint8_t post = typeOf(_description[i].type)->post;
+    if (post == POST_CHECKED)
+    {
+      updateValue(i, s->present.contains(i) ? "1" : "0");
+    }
+    else if (post == POST_INDICES)
+    {
+      String val;
+      for (uint8_t a = 0; a < _description[i].optionCnt; a++)
+        val += (s->checked[i] & (1 << a)) ? '1' : '0';
+      updateValue(i, std::move(val));
+    }
+  }
+  unlock();
+  buttons = s->buttons;
+  uint8_t invalid = s->invalid;
+  delete s;
+  return invalid;
+}
+
+// finish a form body, returns the number of rejected values
+uint8_t WebConfig::endForm(WebConfigFormState *state)
+{
+  uint8_t buttons;
+  return endForm(state, buttons);
+}
+
+// current version of the values
+uint32_t WebConfig::getVersion()
+{
+  return _version;
+}
+
+// random number which changes with every start
+uint32_t WebConfig::getEpoch()
+{
+  return _epoch;
+}
+
+// version of the last change of a field, 0 if it was not changed
+uint32_t WebConfig::getFieldVersion(const char *name)
+{
+  int16_t i = getIndex(name);
+  return (i >= 0) ? _fieldVersion[i] : 0;
+}
+
+// keep the connection of the request open and push changes from loop()
+// transports without event streams answer with the changes once
+void WebConfig::openEvents(WebConfigTransport *server)
+{
+  uint32_t since = strtoul(server->arg(F("since")).c_str(), nullptr, 10);
+  uint32_t epoch = strtoul(server->arg(F("epoch")).c_str(), nullptr, 10);
+  lock();
+  if (_subscriberCnt >= MAXSUBSCRIBERS)
+  {
+    unlock();
+    sendText(server, "text/plain", "", 503);
+    return;
+  }
+  WebConfigEventStream *stream = server->openEvents();
+  if (stream == nullptr)
+  {
+    String json = getChangesJson(since, epoch);
+    unlock();
+    server->sendHeader("Cache-Control", "no-cache");
+    sendText(server, "application/json", json);
+    return;
+  }
+  SUBSCRIBER *sub = new SUBSCRIBER;
+  sub->stream = stream;
+  sub->version = since;
+  if ((epoch != _epoch) || (since > _version))
+  {
+    // a client of a former run gets all fields at once
+    String event = "id: " + String(_version) + "\ndata: " + getChangesJson(0, _epoch) + "\n\n";
+    stream->write(event.c_str());
+    sub->version = _version;
+  }
+  sub->lastSend = millis();
+  sub->next = _subscribers;
+  _subscribers = sub;
+  _subscriberCnt++;
+  unlock();
+}
+
+// send the changes to all event streams, remove closed streams
+void WebConfig::dispatchEvents()
+{
+  uint32_t now = millis();
+  SUBSCRIBER **p = &_subscribers;
+  while (*p != nullptr)
+  {
+    SUBSCRIBER *sub = *p;
+    boolean ok = sub->stream->connected();
+    if (ok && (sub->version < _version))
+    {
+      String event = "id: " + String(_version) + "\ndata: " + getChangesJson(sub->version, _epoch) + "\n\n";
+      ok = sub->stream->write(event.c_str());
+      sub->version = _version;
+      sub->lastSend = now;
+    }
+    else if (ok && ((now - sub->lastSend) >= EVENTKEEPALIVE))
+    {
+      // comment lines keep proxies and the browser from closing the stream
+      ok = sub->stream->write(":\n\n");
+      sub->lastSend = now;
+    }
+    if (ok)
+    {
+      p = &sub->next;
+    }
+    else
+    {
+      *p = sub->next;
+      delete sub->stream;
+      delete sub;
+      _subscriberCnt--;
+    }
+  }
+}
+
+// the options of a field as JSON array of value label pairs
+// provided options are streamed one by one
+void WebConfig::sendOptions(WebConfigTransport *server, uint8_t index)
+{
+  typedef struct
+  {
+    uint16_t option;
+    boolean done;
+    String pending;
+    size_t pos;
+  } OPTIONSTATE;
+  std::shared_ptr<OPTIONSTATE> state = std::make_shared<OPTIONSTATE>();
+  state->option = 0;
+  state->done = false;
+  state->pending = "[";
+  state->pos = 0;
+  server->sendHeader("Cache-Control", "no-cache");
+  server->send(200, "application/json", [this, index, state](uint8_t *buffer, size_t maxLen) -> size_t
+               {
+                 size_t cnt = 0;
+                 String value;
+                 String label;
+                 while (cnt < maxLen)
+                 {
+                   if (state->pos >= state->pending.length())
+                   {
+                     if (state->done)
+                       break;
+                     state->pending = (state->option > 0) ? "," : "";
+                     state->pos = 0;
+                     lock();
+                     boolean found = (index < Staticindex) && getOption(index, state->option, value, label);
+                     unlock();
+                     if (found)
+                     {
+                       state->pending += '[';
+                       jsonString(state->pending, value.c_str());
+                       state->pending += ',';
+                       jsonString(state->pending, label.c_str());
+                       state->pending += ']';
+                       state->option++;
+                     }
+                     else
+                     {
+                       state->pending = "]";
+                       state->done = true;
+                     }
+                   }
+                   size_t n = state->pending.length() - state->pos;
+                   if (n > maxLen - cnt)
+                     n = maxLen - cnt;
+                   memcpy(buffer + cnt, state->pending.c_str() + state->pos, n);
+                   state->pos += n;
+                   cnt += n;
+                 }
+                 return cnt; });
+}
+
+// start rendering the form
+void WebConfig::beginRender(boolean saved, boolean errorSaving)
+{
+  beginRender(_render, saved, errorSaving);
+}
+
+void WebConfig::beginRender(RENDERSTATE &state, boolean saved, boolean errorSaving)
+{
+  state.stage = RS_START;
+  state.field = 0;
+  state.step = 0;
+  state.pos = 0;
+  state.invalid = 0;
+  state.saved = saved;
+  state.errorSaving = errorSaving;
+  state.partial = false;
+  state.section = 0;
+  state.allocs = allocations();
+}
+
+// advance the render state to the next part of the form
+void WebConfig::nextPart(RENDERSTATE &state)
+{
+  switch (state.stage)
+  {
+  case RS_START:
+    state.stage = ((_buttons == BTN_CONFIG) && !state.partial) ? RS_DEVICENAME : RS_PROFILES;
+    break;
+  case RS_DEVICENAME:
+    state.stage = RS_PROFILES;
+    break;
+  case RS_PROFILES:
+    // title, one link per profile and the end of the line
+    state.step++;
+    if (state.step >= _profileCnt + 2)
+    {
+      state.stage = RS_SECTIONS;
+      state.step = 0;
+    }
+    break;
+  case RS_SECTIONS:
+    // title, the whole form, one link per section and the end of the line
+    state.step++;
+    if (state.step >= _sectionCnt + 3)
+    {
+      state.stage = RS_FIELDS;
+      state.step = 0;
+    }
+    break;
+  case RS_FIELDS:
+    state.step++;
+    if (!hasPart(state.field, state.step))
+    {
+      state.field++;
+      state.step = 0;
+    }
+    break;
+  case RS_SAVED:
+    state.stage = RS_LIVE;
+    break;
+  case RS_LIVE:
+    state.stage = RS_END;
+    break;
+  case RS_END:
+    state.stage = RS_DONE;
+    _renderAllocs = allocations() - state.allocs;
+    break;
+  }
+  if ((state.stage == RS_PROFILES) && (_profileCnt == 0))
+    state.stage = RS_SECTIONS;
+  if ((state.stage == RS_SECTIONS) && (_sectionCnt == 0))
+    state.stage = RS_FIELDS;
+  // skip the fields which are not selected
+  while ((state.stage == RS_FIELDS) && (state.step == 0) && state.partial &&
+         (state.field < Staticindex) && !state.fields.contains(state.field))
+    state.field++;
+  if ((state.stage == RS_FIELDS) && (state.field >= Staticindex))
+    state.stage = RS_SAVED;
+  if ((state.stage == RS_SAVED) && !state.saved && (state.invalid == 0))
+    state.stage = RS_LIVE;
+  if ((state.stage == RS_LIVE) && !_liveUpdate)
+    state.stage = RS_END;
+}
+
+// render the current part of the form with out
+// returns false if the form is complete
+boolean WebConfig::renderPart(const RENDERSTATE &state, WebConfigWriter &out)
+{
+  switch (state.stage)
+  {
+  case RS_START:
+    out.printTemplate(HTML_START, _deviceNAme.c_str());
+    out.print("<form method='post'>\n");
+    return true;
+  case RS_DEVICENAME:
+    createSimple(out, "deviceName", "device Name", "text", _deviceNAme.c_str());
+    return true;
+  case RS_PROFILES:
+    if (state.step == 0)
+      out.print(" <div class='zeile'><b>Profile</b></div>\n <div class='zeile'>");
+    else if (state.step <= _profileCnt)
+      renderProfile(out, getProfileName(state.step - 1));
+    else
+      out.print("</div>\n");
+    return true;
+  case RS_SECTIONS:
+    if (state.step == 0)
+      out.print(" <div class='zeile'><b>Sections</b></div>\n <div class='zeile'>");
+    else if (state.step == 1)
+      out.print(state.partial ? "<a href='?'>all</a> " : "<b>all</b> ");
+    else if (state.step <= _sectionCnt + 1)
+      renderLink(out, "wcsection", _sections[state.step - 2], state.section == state.step - 1);
+    else
+      out.print("</div>\n");
+    return true;
+  case RS_FIELDS:
+    if (state.field < Staticindex)
+      renderField(out, state.field, state.step);
+    return true;
+  case RS_SAVED:
+    if (state.invalid > 0)
+      out.printTemplate(HTML_TEX_SIMPLE, "INVALID INPUT IGNORED!");
+    if (state.saved)
+      out.printTemplate(HTML_TEX_SIMPLE, "SAVED!");
+    return true;
+  case RS_LIVE:
+    out.printTemplate(HTML_LIVE, (unsigned long)_version, (unsigned long)_epoch, (unsigned long)_schemaHash);
+    return true;
+  case RS_END:
+    if (_buttons == BTN_CONFIG)
+    {
+      if (state.saved && !state.errorSaving)
+        out.print_P(HTML_END_NOSAVE);
+      else if (!state.saved & state.errorSaving)
+        out.print_P(HTML_END_ERROR_SAVE);
+      else
+        out.print_P(HTML_END);
+    }
+    else
+    {
+      out.print("<div class='zeile'>\n");
+      if ((_buttons & BTN_DONE) == BTN_DONE)
+        out.printTemplate(HTML_BUTTON, "DONE", "Done");
+      if ((_buttons & BTN_CANCEL) == BTN_CANCEL)
+        out.printTemplate(HTML_BUTTON, "CANCEL", "Cancel");
+      if ((_buttons & BTN_DELETE) == BTN_DELETE)
+        out.printTemplate(HTML_BUTTON, "DELETE", "Delete");
+      out.print("</div></form></div></body></html>\n");
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+// link to ?arg=name, the active link is bold
+void WebConfig::renderLink(WebConfigWriter &out, const char *arg, const char *name, boolean active)
+{
+  if (active)
+  {
+    out.printTemplate("<b>%s</b> ", name);
+  }
+  else
+  {
+    out.printTemplate("<a href='?%s=", arg);
+    out.printEncoded(name);
+    out.printTemplate("'>%s</a> ", name);
+  }
+}
+
+// button of a profile, the active profile is bold
+void WebConfig::renderProfile(WebConfigWriter &out, const char *name)
+{
+  if (strcmp(name, getProfile()) == 0)
+  {
+    out.printTemplate("<b>%s</b> ", name);
+  }
+  else
+  {
+    out.print_P(HTML_PROFILE_BUTTON);
+    out.printEncoded(name);
+    out.printTemplate(HTML_PROFILE_BUTTON_END, name);
+  }
+}
+
+// true if the field has a part step, fields with options render one
+// option per part, select and multicheck close with an end tag
+boolean WebConfig::hasPart(uint8_t index, uint16_t step)
+{
+  const WebConfigType *t = typeOf(_description[index].type);
+  return (t->hasPart != nullptr) ? t->hasPart(*this, index, step) : (step == 0);
+}
+
+// render part step of the field with index with out
+// step 0 is the title followed by the options and the end tag
+void WebConfig::renderField(WebConfigWriter &out, uint8_t index, uint16_t step)
+{
+  const DESCRIPTION &d = _description[index];
+  const WebConfigType *t = typeOf(d.type);
+  if (t->render != nullptr)
+    t->render(*this, index, step, valueOf(index), out);
+  else
+    createSimple(out, d.name, d.label, t->input, valueOf(index));
+}
+
+// copy the next part of the form into buffer, at most maxLen bytes
+// returns the number of bytes, 0 if the form is complete
+size_t WebConfig::renderChunk(uint8_t *buffer, size_t maxLen)
+{
+  return renderChunk(_render, buffer, maxLen);
+}
+
+// a part which does not fit is rendered again with the next call and
+// continued at state.pos, the writer copies only the bytes from there on
+size_t WebConfig::renderChunk(RENDERSTATE &state, uint8_t *buffer, size_t maxLen)
+{
+  size_t cnt = 0;
+  while (cnt < maxLen)
+  {
+    WebConfigWriter out(buffer + cnt, maxLen - cnt, state.pos);
+    if (!renderPart(state, out))
+      break;
+    state.pos += out.count();
+    cnt += out.count();
+    if (state.pos >= out.length())
+    {
+      nextPart(state);
+      state.pos = 0;
+    }
+  }
+  return cnt;
+}
+
+// send the form in slices of at most bytes per loop() call
+void WebConfig::setRenderSlice(uint16_t bytes)
+{
+  _renderSlice = bytes;
+}
+
+// true while a sliced form response is pending
+boolean WebConfig::isRendering()
+{
+#if defined(WEBCONFIG_WEBSERVER)
+  return (_serverTransport != nullptr) && _serverTransport->isPending();
+#else
+  return false;
+#endif
+}
+
+// get the index for a value by parameter name
+int16_t WebConfig::getIndex(const char *name)
+{
+  int16_t i = Staticindex - 1;
+  while ((i >= 0) && (strcmp(name, _description[i].name) != 0))
+  {
+    i--;
+  }
+  return i;
+}
+// read configuration from the storage
+boolean WebConfig::readConfig()
+{
+  if (loadConfig())
+    return true;
+  // if there is no stored config write default values
+  return commitConfig();
+}
+
+// load the stored values of all fields
+boolean WebConfig::loadConfig()
+{
+  CONFIGENTRY keys[MAXVALUES + 2];
+  uint8_t cnt = configEntries(keys);
+  Serial.println(F("Read configuration"));
+  _storedProfile = "";
+  boolean ok = _storage->load(keys, cnt, [this](const char *name, const char *value)
+                        {
+    if (strcmp(name, "deviceName") == 0)
+    {
+      if (value[0] != 0)
+        _deviceNAme = value;
+      Serial.printf("%s=%s\n", name, value);
+      return;
+    }
+    if (strcmp(name, "_profile") == 0)
+    {
+      _storedProfile = value;
+      return;
+    }
+    int16_t index = getIndex(name);
+    if (index < 0)
+      return;
+    loadValue(values, _overridden, index, value);
+    if (_description[index].type == INPUTPASSWORD)
+      Serial.printf("%s=*************\n", name);
+    else
+      Serial.printf("%s=%s\n", name, value); });
+  if (ok)
+    loadProfiles();
+  return ok;
+}
+
+// set a value of a value set, with copy on write a value equal to the
+// default is not kept
+void WebConfig::loadValue(String *vals, WebConfigChanges &overridden, uint8_t index, const char *value)
+{
+  if (_copyOnWrite && (strcmp(value, _defaults[index]) == 0))
+  {
+    vals[index] = String();
+    overridden.clear(index);
+  }
+  else
+  {
+    vals[index] = value;
+    overridden.set(index);
+  }
+}
+
+// entries for the storage, the device name and all fields
+uint8_t WebConfig::configEntries(CONFIGENTRY *entries)
+{
+  entries[0].name = "deviceName";
+  entries[0].value = _deviceNAme.c_str();
+  entries[0].kind = STORE_STRING;
+  for (uint8_t i = 0; i < Staticindex; i++)
+  {
+    entries[i + 1].name = _description[i].name;
+    // with copy on write only overridden values are stored
+    entries[i + 1].value = (!_copyOnWrite || _overridden.contains(i)) ? values[i].c_str() : nullptr;
+    entries[i + 1].kind = typeOf(_description[i].type)->store;
+  }
+  // the name of the active profile, removed if there are no profiles
+  entries[Staticindex + 1].name = "_profile";
+  entries[Staticindex + 1].value = (_activeProfile != nullptr) ? _activeProfile->name : nullptr;
+  entries[Staticindex + 1].kind = STORE_STRING;
+  return Staticindex + 2;
+}
+
+// write configuration to default file
+boolean WebConfig::writeConfig()
+{
+  _profilesOnly = false;
+  if (_wbQuiet > 0)
+  {
+    markDirty();
+    return true;
+  }
+  return flush();
+}
+
+// write the config to the storage now
+boolean WebConfig::commitConfig()
+{
+  CONFIGENTRY entries[MAXVALUES + 2];
+  uint8_t cnt = configEntries(entries);
+  uint32_t start = micros();
+  boolean ok = (_profilesOnly || _storage->store(entries, cnt)) && storeProfiles();
+  _commitTime = micros() - start;
+  if (ok)
+    return true;
+  Serial.println(F("Cannot write configuration"));
+  return false;
+}
+
+// duration of the last commit in microseconds
+uint32_t WebConfig::getCommitTime()
+{
+  return _commitTime;
+}
+
+//*************************** profiles ***************************************
+// The active profile uses values[], the other profiles keep their values
+// in RAM. A switch exchanges the strings without copying. The active
+// profile is stored with the config, the other ones as blobs wcp_<name>
+// listed in the blob wcprofiles
+
+WebConfig::PROFILE *WebConfig::findProfile(const char *name)
+{
+  for (PROFILE *p = _profiles; p != nullptr; p = p->next)
+  {
+    if (strcmp(p->name, name) == 0)
+      return p;
+  }
+  return nullptr;
+}
+
+// value of a field in a profile, nullptr for the active values
+const char *WebConfig::profileValue(PROFILE *p, uint8_t index)
+{
+  if ((p == nullptr) || (p == _activeProfile))
+    return valueOf(index);
+  if (!_copyOnWrite || p->overridden.contains(index))
+    return p->values[index].c_str();
+  return _defaults[index];
+}
+
+WebConfig::PROFILE *WebConfig::newProfile(const char *name)
+{
+  PROFILE *p = new PROFILE;
+  strlcpy(p->name, name, PROFILENAMELENGTH);
+  p->dirty = true;
+  p->next = nullptr;
+  // keep the order of creation for the form
+  PROFILE **last = &_profiles;
+  while (*last != nullptr)
+    last = &(*last)->next;
+  *last = p;
+  _profileCnt++;
+  _profileListDirty = true;
+  return p;
+}
+
+// add a profile with a copy of the active values, an existing profile is kept
+boolean WebConfig::addProfile(const char *name)
+{
+  if ((strlen(name) == 0) || (strlen(name) >= PROFILENAMELENGTH))
+    return false;
+  lock();
+  boolean ok = findProfile(name) != nullptr;
+  if (!ok && (_profileCnt < MAXPROFILES))
+  {
+    // the values used so far become the profile default
+    if (_activeProfile == nullptr)
+      _activeProfile = newProfile("default");
+    if (strcmp(name, "default") != 0)
+    {
+      PROFILE *p = newProfile(name);
+      for (uint8_t i = 0; i < Staticindex; i++)
+        p->values[i] = values[i];
+      p->overridden = _overridden;
+    }
+    markDirty();
+    ok = writeConfig();
+  }
+  unlock();
+  return ok;
+}
+
+// remove a profile, the active profile cannot be removed
+boolean WebConfig::removeProfile(const char *name)
+{
+  lock();
+  PROFILE **p = &_profiles;
+  while ((*p != nullptr) && (strcmp((*p)->name, name) != 0))
+    p = &(*p)->next;
+  boolean ok = (*p != nullptr) && (*p != _activeProfile);
+  if (ok)
+  {
+    // name may point into the profile, the key is built before it is deleted
+    char key[16];
+    PROFILE *old = *p;
+    snprintf(key, sizeof(key), "wcp_%s", old->name);
+    *p = old->next;
+    delete old;
+    _profileCnt--;
+    _profileListDirty = true;
+    markDirty();
+    ok = writeConfig();
+    // the values are deleted after the list, a backend without blobs has none
+    if (ok)
+      _storage->removeBlob(key);
+  }
+  unlock();
+  return ok;
+}
+
+// make a profile active. The strings of the active values and of the
+// profile are exchanged, changed fields are reported like a save
+boolean WebConfig::selectProfile(const char *name)
+{
+  lock();
+  PROFILE *p = findProfile(name);
+  if ((p == nullptr) || (p == _activeProfile))
+  {
+    unlock();
+    return p != nullptr;
+  }
+  PROFILE *old = _activeProfile;
+  swapProfile(p);
+  for (uint8_t i = 0; i < Staticindex; i++)
+  {
+    if (strcmp(profileValue(old, i), valueOf(i)) != 0)
+    {
+      _changes.set(i);
+      _fieldVersion[i] = ++_version;
+    }
+  }
+  // without pending changes only the blob of old and the profile list
+  // with the active profile are written, the config keeps the values
+  // of the profile named by _profile
+  old->dirty = true;
+  _profileListDirty = true;
+  boolean profilesOnly = !_dirty;
+  markDirty();
+  _profilesOnly = profilesOnly;
+  boolean ok = (_wbQuiet > 0) || flush();
+  dispatchChanges();
+  unlock();
+  return ok;
+}
+
+// exchange the strings of the active values and of p without copying
+void WebConfig::swapProfile(PROFILE *p)
+{
+  PROFILE *old = _activeProfile;
+  WebConfigChanges ovr = _overridden;
+  for (uint8_t i = 0; i < Staticindex; i++)
+  {
+    // old gets the active values, values[] the values of p
+    std::swap(values[i], old->values[i]);
+    std::swap(values[i], p->values[i]);
+  }
+  _overridden = p->overridden;
+  old->overridden = ovr;
+  p->overridden.clear();
+  _activeProfile = p;
+}
+
+// name of the active profile, empty without profiles
+const char *WebConfig::getProfile()
+{
+  return (_activeProfile != nullptr) ? _activeProfile->name : "";
+}
+
+uint8_t WebConfig::getProfileCount()
+{
+  return _profileCnt;
+}
+
+// name of the profile with index in the order of creation
+const char *WebConfig::getProfileName(uint8_t index)
+{
+  PROFILE *p = _profiles;
+  while ((p != nullptr) && (index-- > 0))
+    p = p->next;
+  return (p != nullptr) ? p->name : "";
+}
+
+// the values of a profile which differ from the defaults or all values
+void WebConfig::writeProfile(SCHEMAWRITER &w, PROFILE *p)
+{
+  uint8_t cnt = 0;
+  for (uint8_t i = 0; i < Staticindex; i++)
+  {
+    if (!_copyOnWrite || p->overridden.contains(i))
+      cnt++;
+  }
+  schemaPut(w, &cnt, 1);
+  for (uint8_t i = 0; i < Staticindex; i++)
+  {
+    if (!_copyOnWrite || p->overridden.contains(i))
+    {
+      schemaPutString(w, _description[i].name);
+      schemaPutString(w, p->values[i].c_str());
+    }
+  }
+}
+
+// write the list of profiles and the changed inactive profiles
+boolean WebConfig::storeProfiles()
+{
+  boolean ok = true;
+  char key[16];
+  uint8_t *buf;
+  SCHEMAWRITER w;
+  if (_profileListDirty)
+  {
+    w = {nullptr, 0};
+    for (uint8_t pass = 0; pass < 2; pass++)
+    {
+      schemaPut(w, &_profileCnt, 1);
+      for (PROFILE *p = _profiles; p != nullptr; p = p->next)
+        schemaPutString(w, p->name);
+      // the active profile, it differs from _profile after a switch
+      schemaPutString(w, _activeProfile->name);
+      if (pass == 0)
+      {
+        buf = new uint8_t[w.pos];
+        w = {buf, 0};
+      }
+    }
+    ok = _storage->storeBlob("wcprofiles", buf, w.pos);
+    _profileListDirty = !ok;
+    delete[] buf;
+  }
+  for (PROFILE *p = _profiles; p != nullptr; p = p->next)
+  {
+    if (!p->dirty || (p == _activeProfile))
+      continue;
+    w = {nullptr, 0};
+    writeProfile(w, p);
+    buf = new uint8_t[w.pos];
+    w = {buf, 0};
+    writeProfile(w, p);
+    snprintf(key, sizeof(key), "wcp_%s", p->name);
+    p->dirty = !_storage->storeBlob(key, buf, w.pos);
+    ok &= !p->dirty;
+    delete[] buf;
+  }
+  return ok;
+}
+
+// read a blob into a new buffer, nullptr if it does not exist
+static uint8_t *readBlob(WebConfigStorage *storage, const char *key, size_t &len)
+{
+  len = storage->blobSize(key);
+  if (len == 0)
+    return nullptr;
+  uint8_t *buf = new uint8_t[len];
+  if (!storage->loadBlob(key, buf, len))
+  {
+    delete[] buf;
+    return nullptr;
+  }
+  return buf;
+}
+
+// read the profiles after the config. The profile named by _profile gets
+// the values just loaded, the active one from the list is selected
+void WebConfig::loadProfiles()
+{
+  size_t len;
+  char key[16];
+  char name[PROFILENAMELENGTH];
+  char active[PROFILENAMELENGTH] = "";
+  String field;
+  String value;
+  uint8_t cnt;
+  while (_profiles != nullptr)
+  {
+    PROFILE *p = _profiles;
+    _profiles = p->next;
+    delete p;
+  }
+  _profileCnt = 0;
+  _activeProfile = nullptr;
+  if (_storedProfile.length() == 0)
+    return;
+  uint8_t *list = readBlob(_storage, "wcprofiles", len);
+  SCHEMAREADER l = {list, 0, len};
+  if ((list != nullptr) && schemaGet(l, &cnt, 1))
+  {
+    for (uint8_t j = 0; (j < cnt) && (_profileCnt < MAXPROFILES) && schemaGetString(l, name, PROFILENAMELENGTH); j++)
+    {
+      PROFILE *p = newProfile(name);
+      p->dirty = false;
+      if (_storedProfile == name)
+      {
+        _activeProfile = p;
+        continue;
+      }
+      // fields without stored value get the default
+      for (uint8_t i = 0; i < Staticindex; i++)
+        loadValue(p->values, p->overridden, i, _defaults[i]);
+      snprintf(key, sizeof(key), "wcp_%s", name);
+      uint8_t *buf = readBlob(_storage, key, len);
+      SCHEMAREADER r = {buf, 0, len};
+      uint8_t n = 0;
+      if ((buf != nullptr) && schemaGet(r, &n, 1))
+      {
+        for (uint8_t k = 0; (k < n) && schemaGetString(r, field) && schemaGetString(r, value); k++)
+        {
+          int16_t i = getIndex(field.c_str());
+          if (i >= 0)
+            loadValue(p->values, p->overridden, i, value.c_str());
+        }
+      }
+      delete[] buf;
+    }
+    // missing in lists written before a switch was stored separately
+    if (!schemaGetString(l, active, PROFILENAMELENGTH))
+      active[0] = 0;
+  }
+  delete[] list;
+  _profileListDirty = false;
+  // the list does not match the config, start again with one profile
+  if (_activeProfile == nullptr)
+  {
+    _activeProfile = newProfile(_storedProfile.c_str());
+  }
+  // a switch after the last commit, the profile of the config values
+  // gets its blob written with the next commit
+  PROFILE *p = findProfile(active);
+  if ((p != nullptr) && (p != _activeProfile))
+  {
+    PROFILE *owner = _activeProfile;
+    swapProfile(p);
+    owner->dirty = true;
+  }
+}
+
+// enable or disable write-behind mode
+void WebConfig::setWriteBehind(uint32_t quietMs, uint32_t maxDelayMs)
+{
+  _wbQuiet = quietMs;
+  _wbMaxDelay = maxDelayMs;
+}
+
+// remember a change for the write-behind scheduler
+void WebConfig::markDirty()
+{
+  // a change of the config entries needs a complete commit
+  _profilesOnly = false;
+  _lastChange = millis();
+  if (!_dirty)
+  {
+    _firstChange = _lastChange;
+    _dirty = true;
+  }
+}
+
+// commit pending changes if the quiet period or the deadline has expired
+void WebConfig::loop()
+{
+#if defined(WEBCONFIG_WEBSERVER)
+  if (_serverTransport != nullptr)
+    _serverTransport->loop();
+#endif
+  if (_subscribers != nullptr)
+  {
+    lock();
+    dispatchEvents();
+    unlock();
+  }
+  if (!_dirty || (_wbQuiet == 0))
+    return;
+  lock();
+  uint32_t now = millis();
+  if (((now - _lastChange) >= _wbQuiet) ||
+      ((_wbMaxDelay > 0) && ((now - _firstChange) >= _wbMaxDelay)))
+  {
+    if (!flush())
+    {
+      // retry after the next quiet period
+      _lastChange = now;
+      _firstChange = now;
+    }
+  }
+  unlock();
+}
+
+// commit pending changes immediately
+boolean WebConfig::flush()
+{
+  if (!_dirty && (_wbQuiet > 0))
+    return true;
+  lock();
+  boolean ok = commitConfig();
+  if (ok)
+  {
+    _dirty = false;
+    _profilesOnly = false;
+  }
+  unlock();
+  return ok;
+}
+
+boolean WebConfig::isDirty()
+{
+  return _dirty;
+}
+// delete configuration file
+boolean WebConfig::deleteConfig(const char *filename)
+{
+#if defined(ESP32) || defined(ESP8266)
+  return LittleFS.remove(filename);
+#else
+  return false;
+#endif
+}
+
+// delete the stored config, kept for compatibility
+boolean WebConfig::deleteConfigNVS()
+{
+  return deleteConfig();
+}
+
+// delete the stored config
+boolean WebConfig::deleteConfig()
+{
+  return _storage->remove();
+}
+
+// get a parameter value by its name
+const String WebConfig::getString(const char *name)
+{
+  int16_t index;
+  index = getIndex(name);
+  if (index < 0)
+  {
+    return "";
+  }
+  else
+  {
+    return valueOf(index);
+  }
+}
+
+// Get results as a JSON string
+String WebConfig::getResults()
+{
+  return getResults(nullptr);
+}
+
+// capacity of the results of profile p, the names and the strings are
+// copied into the document
+size_t WebConfig::resultsCapacity(PROFILE *p)
+{
+  size_t capacity = JSON_OBJECT_SIZE(Staticindex);
+  for (uint8_t i = 0; i < Staticindex; i++)
+  {
+    capacity += strlen(_description[i].name) + 1;
+    if (typeOf(_description[i].type)->result == STORE_STRING)
+      capacity += strlen(profileValue(p, i)) + 1;
+  }
+  return capacity;
+}
+
+// the results of profile p into doc, a char* is copied by ArduinoJson so
+// the document stays valid when the values change
+void WebConfig::fillResults(JsonDocument &doc, PROFILE *p)
+{
+  long n;
+  double d;
+  for (uint8_t i = 0; i < Staticindex; i++)
+  {
+    const char *value = profileValue(p, i);
+    switch (typeOf(_description[i].type)->result)
+    {
+    case STORE_INT:
+      storedInteger(value, n);
+      doc[(char *)_description[i].name] = n;
+      break;
+    case STORE_FLOAT:
+      storedNumber(value, d);
+      doc[(char *)_description[i].name] = d;
+      break;
+    default:
+      doc[(char *)_description[i].name] = (char *)value;
+    }
+  }
+}
+
+// results of a profile, nullptr or an unknown name for the active values
+String WebConfig::getResults(const char *profile)
+{
+  String json;
+  lock();
+  PROFILE *p = (profile != nullptr) ? findProfile(profile) : nullptr;
+  // the document is sized from the values, long texts are not truncated
+  DynamicJsonDocument doc(resultsCapacity(p));
+  fillResults(doc, p);
+  unlock();
+  json.reserve(measureJson(doc));
+  serializeJson(doc, json);
+  return json;
+}
+
+// the results in a document owned by the instance, it is valid until the
+// next call
+JsonObject WebConfig::getResultsJson()
+{
+  lock();
+  delete _results;
+  _results = new DynamicJsonDocument(resultsCapacity(nullptr));
+  fillResults(*_results, nullptr);
+  unlock();
+  return _results->as<JsonObject>();
+}
+
+// Ser values from a JSON string
+void WebConfig::setValues(String json)
+{
+  char num[NUMBERLENGTH];
+  DeserializationError error;
+  // the strings of the input are copied, they never exceed its length
+  DynamicJsonDocument doc(JSON_OBJECT_SIZE(MAXVALUES) + json.length());
+  error = deserializeJson(doc, json);
+  if (error)
+  {
+    Serial.print("JSON: ");
+    Serial.println(error.c_str());
+  }
+  else
+  {
+    lock();
+    for (uint8_t i = 0; i < Staticindex; i++)
+    {
+      if (doc.containsKey(_description[i].name))
+      {
+        switch (typeOf(_description[i].type)->result)
+        {
+        case STORE_INT:
+          formatInteger(num, doc[_description[i].name].as<long>());
+          updateValue(i, num);
+          break;
+        case STORE_FLOAT:
+          formatDouble(num, doc[_description[i].name].as<double>());
+          updateValue(i, num);
+          break;
+        default:
+          // values which are not strings are rejected
+          if (doc[_description[i].name].is<const char *>())
+            updateValue(i, doc[_description[i].name].as<const char *>());
+        }
+      }
+    }
+    dispatchChanges();
+    unlock();
+  }
+}
+
+//************************** binary results **********************************
+// the results as MessagePack or CBOR map of name and value. Numbers are
+// encoded as integers or floats like in getResults(), all other fields as
+// strings. Integers use the shortest form, floats are written as float32
+// if that is exact and as float64 otherwise
+
+struct BINWRITER
+{
+  Print &out;
+  uint8_t format;
+  size_t len;
+};
+
+// write the n lower bytes of v big endian
+static void binPut(BINWRITER &w, uint64_t v, uint8_t n)
+{
+  uint8_t b[8];
+  for (uint8_t i = 0; i < n; i++)
+    b[i] = v >> (8 * (n - 1 - i));
+  w.len += w.out.write(b, n);
+}
+
+// CBOR head with major type and the argument in the shortest form
+static void cborHead(BINWRITER &w, uint8_t major, uint64_t arg)
+{
+  major <<= 5;
+  if (arg < 24)
   {
-    _onSaveJson(getResultsJson());
+    binPut(w, major | arg, 1);
   }
-  if (server->hasArg(F("SAVE")) && _onSave_null)
+  else
   {
-    _onSave_null();
+    uint8_t n = (arg <= 0xFF) ? 0 : (arg <= 0xFFFF) ? 1 : (arg <= 0xFFFFFFFFUL) ? 2 : 3;
+    binPut(w, major | (24 + n), 1);
+    binPut(w, arg, 1 << n);
   }
-  if (server->hasArg(F("DONE")) && _onDone)
+}
+
+static void binMap(BINWRITER &w, uint8_t count)
+{
+  if (w.format == RESULTS_CBOR)
+    cborHead(w, 5, count);
+  else if (count < 16)
+    binPut(w, 0x80 | count, 1);
+  else
+    binPut(w, 0xDE0000UL | count, 3);
+}
+
+static void binString(BINWRITER &w, const char *s)
+{
+  uint32_t len = strlen(s);
+  if (w.format == RESULTS_CBOR)
+    cborHead(w, 3, len);
+  else if (len < 32)
+    binPut(w, 0xA0 | len, 1);
+  else if (len <= 0xFF)
+    binPut(w, 0xD900 | len, 2);
+  else if (len <= 0xFFFF)
+    binPut(w, 0xDA0000UL | len, 3);
+  else
+    binPut(w, 0xDB00000000ULL | len, 5);
+  w.len += w.out.write((const uint8_t *)s, len);
+}
+
+static void binInt(BINWRITER &w, int64_t v)
+{
+  if (w.format == RESULTS_CBOR)
   {
-    _onDone(getResults());
-    exit = true;
+    if (v >= 0)
+      cborHead(w, 0, v);
+    else
+      cborHead(w, 1, -1 - v);
   }
-  if (server->hasArg(F("CANCEL")) && _onCancel)
+  else if ((v >= -32) && (v < 128))
   {
-    _onCancel();
-    exit = true;
+    binPut(w, (uint8_t)v, 1);
   }
-  if (server->hasArg(F("DELETE")) && _onDelete)
+  else if (v > 0)
   {
-    _onDelete(_deviceNAme);
-    exit = true;
+    uint8_t n = (v <= 0xFF) ? 0 : (v <= 0xFFFF) ? 1 : (v <= 0xFFFFFFFFLL) ? 2 : 3;
+    binPut(w, 0xCC + n, 1);
+    binPut(w, v, 1 << n);
   }
-  if (!exit)
+  else
   {
-    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
-    sprintf(_buf, HTML_START, _deviceNAme.c_str());
-    server->send(200, "text/html", _buf);
-    if (_buttons == BTN_CONFIG)
-    {
-      createSimple(_buf, "deviceName", "device Name", "text", _deviceNAme);
-      server->sendContent(_buf);
-    }
+    uint8_t n = (v >= -128) ? 0 : (v >= -32768) ? 1 : (v >= INT32_MIN) ? 2 : 3;
+    binPut(w, 0xD0 + n, 1);
+    binPut(w, v, 1 << n);
+  }
+}
 
-    for (uint8_t i = 0; i < Staticindex; i++)
-    {
-      switch (_description[i].type)
-      {
-      case INPUTFLOAT:
-      case INPUTTEXT:
-        createSimple(_buf, _description[i].name, _description[i].label, "text", values[i]);
-        break;
-      case INPUTTEXTAREA:
-        createTextarea(_buf, _description[i], values[i]);
-        break;
-      case INPUTPASSWORD:
-        createSimple(_buf, _description[i].name, _description[i].label, "password", values[i]);
-        break;
-      case INPUTDATE:
-        createSimple(_buf, _description[i].name, _description[i].label, "date", values[i]);
-        break;
-      case INPUTTIME:
-        createSimple(_buf, _description[i].name, _description[i].label, "time", values[i]);
-        break;
-      case INPUTCOLOR:
-        createSimple(_buf, _description[i].name, _description[i].label, "color", values[i]);
-        break;
-      case INPUTNUMBER:
-        createNumber(_buf, _description[i], values[i]);
-        break;
-      case INPUTRANGE:
-        createRange(_buf, _description[i], values[i]);
-        break;
-      case INPUTCHECKBOX:
-        createCheckbox(_buf, _description[i], values[i]);
-        break;
-      case INPUTRADIO:
-        sprintf(_buf, HTML_ENTRY_RADIO_TITLE, _description[i].label);
-        for (uint8_t j = 0; j < _description[i].optionCnt; j++)
-        {
-          server->sendContent(_buf);
-          createRadio(_buf, _description[i], values[i], j);
-        }
-        break;
-      case INPUTSELECT:
-        startSelect(_buf, _description[i]);
-        for (uint8_t j = 0; j < _description[i].optionCnt; j++)
-        {
-          server->sendContent(_buf);
-          addSelectOption(_buf, _description[i].options[j], _description[i].labels[j], values[i]);
-        }
-        server->sendContent(_buf);
-        strcpy_P(_buf, HTML_ENTRY_SELECT_END);
-        break;
-      case INPUTMULTICHECK:
-        startMulti(_buf, _description[i]);
-        for (uint8_t j = 0; j < _description[i].optionCnt; j++)
-        {
-          server->sendContent(_buf);
-          addMultiOption(_buf, _description[i].name, j, _description[i].labels[j], values[i]);
-        }
-        server->sendContent(_buf);
-        strcpy_P(_buf, HTML_ENTRY_MULTI_END);
-        break;
-      default:
-        _buf[0] = 0;
-        break;
-      }
-      server->sendContent(_buf);
-    }
-    if (saved)
-    {
-      sprintf(_buf, HTML_TEX_SIMPLE, "SAVED!");
-      server->sendContent(_buf);
-    }
-    if (_buttons == BTN_CONFIG)
-    {
-      if (saved && !errorSaving)
-        server->sendContent(HTML_END_NOSAVE);
-      else if (!saved & errorSaving)
-      {
-        server->sendContent(HTML_END_ERROR_SAVE);
-      }
-      else
-        server->sendContent(HTML_END);
-    }
-    else
-    {
-      server->sendContent("<div class='zeile'>\n");
-      if ((_buttons & BTN_DONE) == BTN_DONE)
-      {
-        sprintf(_buf, HTML_BUTTON, "DONE", "Done");
-        server->sendContent(_buf);
-      }
-      if ((_buttons & BTN_CANCEL) == BTN_CANCEL)
-      {
-        sprintf(_buf, HTML_BUTTON, "CANCEL", "Cancel");
-        server->sendContent(_buf);
-      }
-      if ((_buttons & BTN_DELETE) == BTN_DELETE)
-      {
-        sprintf(_buf, HTML_BUTTON, "DELETE", "Delete");
-        server->sendContent(_buf);
-      }
-      server->sendContent("</div></form></div></body></html>\n");
-    }
+static void binFloat(BINWRITER &w, double v)
+{
+  float f = v;
+  if ((double)f == v)
+  {
+    uint32_t bits;
+    memcpy(&bits, &f, 4);
+    binPut(w, (w.format == RESULTS_CBOR) ? 0xFA : 0xCA, 1);
+    binPut(w, bits, 4);
+  }
+  else
+  {
+    uint64_t bits;
+    memcpy(&bits, &v, 8);
+    binPut(w, (w.format == RESULTS_CBOR) ? 0xFB : 0xCB, 1);
+    binPut(w, bits, 8);
   }
 }
-// get the index for a value by parameter name
-int16_t WebConfig::getIndex(const char *name)
+
+// results of a profile, nullptr or an unknown name for the active values
+size_t WebConfig::writeResults(Print &out, uint8_t format, const char *profile)
 {
-  int16_t i = Staticindex - 1;
-  while ((i >= 0) && (strcmp(name, _description[i].name) != 0))
+  BINWRITER w = {out, format, 0};
+  long n;
+  double d;
+  lock();
+  PROFILE *p = (profile != nullptr) ? findProfile(profile) : nullptr;
+  binMap(w, Staticindex);
+  for (uint8_t i = 0; i < Staticindex; i++)
   {
-    i--;
+    const char *value = profileValue(p, i);
+    binString(w, _description[i].name);
+    switch (typeOf(_description[i].type)->result)
+    {
+    case STORE_INT:
+      storedInteger(value, n);
+      binInt(w, n);
+      break;
+    case STORE_FLOAT:
+      storedNumber(value, d);
+      binFloat(w, d);
+      break;
+    default:
+      binString(w, value);
+    }
   }
-  return i;
+  unlock();
+  return w.len;
 }
-// read configuration from file
-boolean WebConfig::readConfig()
+
+// decoded head of a MessagePack or CBOR item
+enum
 {
-  if (isNVS)
+  BIN_INT,
+  BIN_FLOAT,
+  BIN_BOOL,
+  BIN_NIL,
+  BIN_STRING,
+  BIN_MAP
+};
+
+struct BINITEM
+{
+  uint8_t kind;
+  int64_t i;
+  double f;
+  //float32 or float16 on the wire
+  boolean single;
+  uint32_t len;
+};
+
+struct BINREADER
+{
+  Stream &in;
+  uint8_t format;
+};
+
+// read n bytes big endian
+static boolean binGet(BINREADER &r, uint64_t &v, uint8_t n)
+{
+  uint8_t b[8];
+  if (r.in.readBytes((char *)b, n) != n)
     return false;
-  String line, name, value;
-  uint8_t pos;
-  int16_t index;
-  if (!LittleFS.exists(CONFFILE))
+  v = 0;
+  for (uint8_t i = 0; i < n; i++)
+    v = (v << 8) | b[i];
+  return true;
+}
+
+static boolean binGetFloat(BINREADER &r, BINITEM &item, uint8_t n)
+{
+  uint64_t v;
+  if (!binGet(r, v, n))
+    return false;
+  item.kind = BIN_FLOAT;
+  item.single = n < 8;
+  if (n == 2)
   {
-    // if configfile does not exist write default values
-    writeConfig(CONFFILE);
+    // CBOR half precision
+    int e = (v >> 10) & 0x1F;
+    int m = v & 0x3FF;
+    item.f = (e == 0) ? ldexp(m, -24) : (e < 31) ? ldexp(m + 1024, e - 25) : (m == 0) ? INFINITY : NAN;
+    if (v & 0x8000)
+      item.f = -item.f;
   }
-  File f = LittleFS.open(CONFFILE, "r");
-  if (f)
+  else if (n == 4)
   {
-    Serial.println(F("Read configuration"));
-    uint32_t size = f.size();
-    while (f.position() < size)
-    {
-      line = f.readStringUntil(10);
-      pos = line.indexOf('=');
-      name = line.substring(0, pos);
-      value = line.substring(pos + 1);
-      if ((name == "deviceName") && (value != ""))
-      {
-        _deviceNAme = value;
-        Serial.println(line);
-      }
-      else
-      {
-        index = getIndex(name.c_str());
-        if (!(index < 0))
-        {
-          value.replace("~", "\n");
-          values[index] = value;
-          if (_description[index].type == INPUTPASSWORD)
-          {
-            Serial.printf("%s=*************\n", _description[index].name);
-          }
-          else
-          {
-            Serial.println(line);
-          }
-        }
-      }
-    }
-    f.close();
-    return true;
+    uint32_t bits = v;
+    float f;
+    memcpy(&f, &bits, 4);
+    item.f = f;
   }
   else
   {
-    Serial.println(F("Cannot read configuration"));
-    return false;
+    memcpy(&item.f, &v, 8);
   }
+  return true;
 }
 
-// write configuration to file
-boolean WebConfig::writeConfig(const char *filename)
+// CBOR item, indefinite lengths are not supported
+static boolean cborItem(BINREADER &r, BINITEM &item, uint8_t c)
 {
-  if (isNVS)
+  uint8_t major = c >> 5;
+  uint8_t info = c & 0x1F;
+  uint64_t arg = info;
+  if (major == 7)
+  {
+    item.kind = ((info == 20) || (info == 21)) ? BIN_BOOL : BIN_NIL;
+    item.i = info == 21;
+    if ((info >= 25) && (info <= 27))
+      return binGetFloat(r, item, 1 << (info - 24));
+    return (info >= 20) && (info <= 23);
+  }
+  if ((info >= 28) || ((info >= 24) && !binGet(r, arg, 1 << (info - 24))))
     return false;
-  String val;
-  File f = LittleFS.open(filename, "w");
-  if (f)
+  item.i = (major == 1) ? -1 - (int64_t)arg : arg;
+  item.len = arg;
+  switch (major)
   {
-    f.printf("deviceName=%s\n", _deviceNAme.c_str());
-    for (uint8_t i = 0; i < Staticindex; i++)
-    {
-      val = values[i];
-      val.replace("\n", "~");
-      f.printf("%s=%s\n", _description[i].name, val.c_str());
-    }
+  case 0:
+  case 1:
+    item.kind = BIN_INT;
+    return true;
+  case 3:
+    item.kind = BIN_STRING;
     return true;
+  case 5:
+    item.kind = BIN_MAP;
+    return true;
+  default:
+    return false;
   }
-  else
+}
+
+// MessagePack item, arrays, binaries and extensions are not supported
+static boolean msgpackItem(BINREADER &r, BINITEM &item, uint8_t c)
+{
+  uint64_t v;
+  if ((c < 0x80) || (c >= 0xE0))
+  {
+    item.kind = BIN_INT;
+    item.i = (int8_t)c;
+    if (c < 0x80)
+      item.i = c;
+    return true;
+  }
+  if (c < 0x90)
+  {
+    item.kind = BIN_MAP;
+    item.len = c & 0x0F;
+    return true;
+  }
+  if ((c >= 0xA0) && (c < 0xC0))
   {
-    Serial.println(F("Cannot write configuration"));
+    item.kind = BIN_STRING;
+    item.len = c & 0x1F;
+    return true;
+  }
+  switch (c)
+  {
+  case 0xC0:
+    item.kind = BIN_NIL;
+    return true;
+  case 0xC2:
+  case 0xC3:
+    item.kind = BIN_BOOL;
+    item.i = c == 0xC3;
+    return true;
+  case 0xCA:
+    return binGetFloat(r, item, 4);
+  case 0xCB:
+    return binGetFloat(r, item, 8);
+  case 0xCC:
+  case 0xCD:
+  case 0xCE:
+  case 0xCF:
+    item.kind = BIN_INT;
+    if (!binGet(r, v, 1 << (c - 0xCC)))
+      return false;
+    item.i = v;
+    return true;
+  case 0xD0:
+  case 0xD1:
+  case 0xD2:
+  case 0xD3:
+  {
+    // sign extension of the n byte value
+    uint8_t n = 1 << (c - 0xD0);
+    item.kind = BIN_INT;
+    if (!binGet(r, v, n))
+      return false;
+    item.i = (n == 8) ? (int64_t)v : (int64_t)(v << (64 - 8 * n)) >> (64 - 8 * n);
+    return true;
+  }
+  case 0xD9:
+  case 0xDA:
+  case 0xDB:
+    item.kind = BIN_STRING;
+    if (!binGet(r, v, 1 << (c - 0xD9)))
+      return false;
+    item.len = v;
+    return true;
+  case 0xDE:
+  case 0xDF:
+    item.kind = BIN_MAP;
+    if (!binGet(r, v, (c == 0xDE) ? 2 : 4))
+      return false;
+    item.len = v;
+    return true;
+  default:
     return false;
   }
 }
-#if defined(ESP32)
-boolean WebConfig::writeConfigNVS()
+
+static boolean binItem(BINREADER &r, BINITEM &item)
 {
-  String val;
-  Preferences preferences;
-  boolean ret = preferences.begin(nameSpace.c_str(), false);
-  bool NOerrorOccured = true;
-  if (ret)
+  int c = r.in.read();
+  if (c < 0)
+    return false;
+  return (r.format == RESULTS_CBOR) ? cborItem(r, item, c) : msgpackItem(r, item, c);
+}
+
+// read a string of len bytes into s, without s the string is skipped
+static boolean binGetString(BINREADER &r, uint32_t len, String *s)
+{
+  char buf[32];
+  if (s != nullptr)
+    s->reserve(len);
+  while (len > 0)
   {
-    preferences.putString("deviceName", _deviceNAme.c_str());
-    for (uint8_t i = 0; i < Staticindex; i++)
+    uint8_t n = (len < sizeof(buf)) ? len : sizeof(buf);
+    if (r.in.readBytes(buf, n) != n)
+      return false;
+    if (s != nullptr)
+      s->concat(buf, n);
+    len -= n;
+  }
+  return true;
+}
+
+// set the fields of a map, fields read before an error keep their values.
+// The stream is decoded without the lock, a slow stream does not block
+// the other tasks, only the decoded values are set with the lock
+boolean WebConfig::readValues(Stream &in, uint8_t format)
+{
+  BINREADER r = {in, format};
+  BINITEM item;
+  String name;
+  String value;
+  String vals[MAXVALUES];
+  WebConfigChanges read;
+  char num[NUMBERLENGTH];
+  if (!binItem(r, item) || (item.kind != BIN_MAP))
+    return false;
+  boolean ok = true;
+  for (uint32_t n = item.len; ok && (n > 0); n--)
+  {
+    ok = binItem(r, item) && (item.kind == BIN_STRING) && (item.len < NAMELENGTH) &&
+         binGetString(r, item.len, &(name = "")) && binItem(r, item);
+    if (!ok)
+      break;
+    lock();
+    int16_t i = getIndex(name.c_str());
+    uint16_t maxLength = (i >= 0) ? _description[i].maxLength : 0;
+    unlock();
+    value = "";
+    switch (item.kind)
     {
-      val = values[i];
-      val.replace("\n", "~");
-      // NOerrorOccured &=
-      size_t result;
-      switch (_description[i].type)
+    case BIN_STRING:
+      // a value longer than the limit of its field is skipped
+      if ((i >= 0) && (item.len > maxLength))
       {
-      case INPUTPASSWORD:
-      case INPUTSELECT:
-      case INPUTDATE:
-      case INPUTTIME:
-      case INPUTRADIO:
-      case INPUTCOLOR:
-      case INPUTTEXT:
-        result = preferences.putString(_description[i].name, val);
-        break;
-      case INPUTCHECKBOX:
-      case INPUTRANGE:
-      case INPUTNUMBER:
-        result = preferences.putInt(_description[i].name, val.toInt());
-        break;
-      case INPUTFLOAT:
-        result = preferences.putFloat(_description[i].name, val.toFloat());
-        break;
-      default:
-        result = 0;
-        break;
+        Serial.printf("Value for %s too long\n", name.c_str());
+        i = -1;
       }
-      Serial.printf("saving to nvs %s:%s ,returned %d \n\r", _description[i].name, val.c_str(), result);
-      NOerrorOccured &= result > 0;
+      ok = binGetString(r, item.len, (i >= 0) ? &value : nullptr);
+      break;
+    case BIN_INT:
+      formatInteger(num, item.i);
+      value = num;
+      break;
+    case BIN_FLOAT:
+      if (item.single)
+        formatFloat(num, item.f);
+      else
+        formatDouble(num, item.f);
+      value = num;
+      break;
+    case BIN_BOOL:
+      value = item.i ? "1" : "0";
+      break;
+    case BIN_NIL:
+      i = -1;
+      break;
+    default:
+      // nested maps are not supported
+      ok = false;
+    }
+    if (ok && (i >= 0))
+    {
+      vals[i] = std::move(value);
+      read.set(i);
     }
-    return NOerrorOccured;
   }
-  else
+  lock();
+  for (uint8_t i = 0; i < Staticindex; i++)
   {
-    Serial.println(F("Cannot write configuration to nvs "));
-    return false;
+    if (read.contains(i))
+      updateValue(i, std::move(vals[i]));
   }
+  dispatchChanges();
+  unlock();
+  return ok;
 }
-#endif
 
-// write configuration to default file
-boolean WebConfig::writeConfig()
+const char *WebConfig::getValue(const char *name)
 {
-  if (isNVS)
-    return writeConfigNVS();
+  int16_t index;
+  index = getIndex(name);
+  if (index < 0)
+  {
+    return "";
+  }
   else
-    return writeConfig(CONFFILE);
+  {
+    return valueOf(index);
+  }
 }
-// delete configuration file
-boolean WebConfig::deleteConfig(const char *filename)
+
+// the numbers are parsed from the stored text without a String copy,
+// a value which is no number reads as 0
+int WebConfig::getInt(const char *name)
 {
-  return LittleFS.remove(filename);
+  long n;
+  storedInteger(getValue(name), n);
+  return n;
 }
 
-#if defined(ESP32)
-boolean WebConfig::deleteConfigNVS()
+float WebConfig::getFloat(const char *name)
 {
-  Preferences preferences;
-  if (preferences.begin(nameSpace.c_str(), false))
-    return preferences.clear();
-  return false;
+  double d;
+  storedNumber(getValue(name), d);
+  return d;
+}
+
+boolean WebConfig::getBool(const char *name)
+{
+  return strcmp(getValue(name), "0") != 0;
+}
+
+// get the accesspoint name
+const char *WebConfig::getDeviceName()
+{
+  return _deviceNAme.c_str();
+}
+// get the number of parameters
+uint8_t WebConfig::getCount()
+{
+  return Staticindex;
+}
+
+// get the name of a parameter
+String WebConfig::getName(uint8_t index)
+{
+  if (index < Staticindex)
+  {
+    return String(_description[index].name);
+  }
+  else
+  {
+    return "";
+  }
+}
+
+// set the value for a parameter
+void WebConfig::setValue(const char *name, String value)
+{
+  int16_t i = getIndex(name);
+  if (i >= 0)
+  {
+    lock();
+    updateValue(i, value);
+    unlock();
+  }
 }
+
+// serialize access from the async server task and loop()
+void WebConfig::lock()
+{
+#if defined(ESP32)
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
 #endif
+}
 
-// delete default configutation file
-boolean WebConfig::deleteConfig()
+void WebConfig::unlock()
 {
-  return deleteConfig(CONFFILE);
+#if defined(ESP32)
+  xSemaphoreGiveRecursive(_lock);
+#endif
 }
 
-// get a parameter value by its name
-const String WebConfig::getString(const char *name)
+// validate a value and set it, mark the config dirty if it has changed
+// returns false if the value was rejected. The value is taken over, a
+// temporary passed by the caller is moved into the slot without a copy
+boolean WebConfig::updateValue(uint8_t index, String val)
 {
-  int16_t index;
-  index = getIndex(name);
-  if (index < 0)
+  if (!validateValue(index, val))
   {
-    return "";
+    Serial.printf("Invalid value for %s rejected\n", _description[index].name);
+    return false;
   }
-  else
+  if (strcmp(valueOf(index), val.c_str()) != 0)
   {
-    return values[index];
+    if (_copyOnWrite && (val == _defaults[index]))
+    {
+      // back to the default, release the copy
+      values[index] = String();
+      _overridden.clear(index);
+    }
+    else
+    {
+      values[index] = std::move(val);
+      _overridden.set(index);
+    }
+    _changes.set(index);
+    _fieldVersion[index] = ++_version;
+    markDirty();
   }
+  return true;
 }
 
-#if defined(ESP32)
-const String WebConfig::getStringNVS(const char *name)
+// FNV-1a hash of a string
+uint32_t WebConfig::hashString(const char *s, uint32_t h)
 {
-  Preferences p;
-  if (p.begin(this->nameSpace.c_str()))
+  while (*s != 0)
   {
-    if (p.isKey(name))
-    {
-      return p.getString(name);
-    }
+    h ^= (uint8_t)*s++;
+    h *= 16777619UL;
   }
-  return "";
+  return h;
 }
 
-int WebConfig::getIntNVS(const char *name)
+// true if s has the format of pattern, 9 stands for any digit, x for a
+// hex digit, other characters have to match
+static boolean matchPattern(const char *s, const char *pattern)
 {
-  Preferences p;
-  if (p.begin(this->nameSpace.c_str()))
+  while ((*s != 0) && (*pattern != 0))
   {
-    if (p.isKey(name))
+    if (*pattern == '9')
+    {
+      if (!isdigit(*s))
+        return false;
+    }
+    else if (*pattern == 'x')
+    {
+      if (!isxdigit(*s))
+        return false;
+    }
+    else if (*s != *pattern)
     {
-      return p.getInt(name);
+      return false;
     }
+    s++;
+    pattern++;
   }
-  return 0x7FFFFFFF;
+  return (*s == 0) && (*pattern == 0);
 }
 
-float WebConfig::getfloatNVS(const char *name)
+// find a table with the same options and labels in the pool or create
+// a new one. Values and labels are copied into one block, a label equal
+// to its value is stored only once
+OPTIONTABLE *WebConfig::internOptions(const char *const *options, const char *const *labels, uint8_t count)
 {
-  Preferences p;
-  if (p.begin(this->nameSpace.c_str()))
+  if (count == 0)
+    return nullptr;
+  uint32_t h = 2166136261UL;
+  size_t len = 0;
+  for (uint8_t j = 0; j < count; j++)
+  {
+    // the terminators are part of the hash to separate the strings
+    h = hashString(options[j], h) * 16777619UL;
+    h = hashString(labels[j], h) * 16777619UL;
+    len += strlen(options[j]) + 1;
+    if (strcmp(labels[j], options[j]) != 0)
+      len += strlen(labels[j]) + 1;
+  }
+  for (OPTIONTABLE *t = _optionTables; t != nullptr; t = t->next)
+  {
+    if ((t->hash != h) || (t->count != count))
+      continue;
+    uint8_t j = 0;
+    while ((j < count) && (strcmp(t->option(j), options[j]) == 0) && (strcmp(t->label(j), labels[j]) == 0))
+      j++;
+    if (j == count)
+    {
+      t->refs++;
+      return t;
+    }
+  }
+  OPTIONTABLE *t = new OPTIONTABLE;
+  t->hash = h;
+  t->refs = 1;
+  t->count = count;
+  t->offsets = new uint16_t[2 * count];
+  t->data = new char[len];
+  t->hashes = new OPTIONHASH[count];
+  uint16_t pos = 0;
+  for (uint8_t j = 0; j < count; j++)
   {
-    if (p.isKey(name))
+    t->offsets[2 * j] = pos;
+    strcpy(t->data + pos, options[j]);
+    pos += strlen(options[j]) + 1;
+    if (strcmp(labels[j], options[j]) == 0)
+    {
+      t->offsets[2 * j + 1] = t->offsets[2 * j];
+    }
+    else
+    {
+      t->offsets[2 * j + 1] = pos;
+      strcpy(t->data + pos, labels[j]);
+      pos += strlen(labels[j]) + 1;
+    }
+    // insertion sort, option lists are short
+    uint32_t oh = hashString(options[j]);
+    uint8_t k = j;
+    while ((k > 0) && (t->hashes[k - 1].hash > oh))
     {
-      return p.getFloat(name);
+      t->hashes[k] = t->hashes[k - 1];
+      k--;
     }
+    t->hashes[k].hash = oh;
+    t->hashes[k].index = j;
   }
-  return 0x7FFFFFFF;
+  t->next = _optionTables;
+  _optionTables = t;
+  return t;
 }
-#endif
 
-// Get results as a JSON string
-String WebConfig::getResults()
+// drop one reference, the last one frees the table
+void WebConfig::releaseOptions(OPTIONTABLE *table)
 {
-  char buffer[1024];
-  StaticJsonDocument<1000> doc;
-  for (uint8_t i = 0; i < Staticindex; i++)
+  if ((table == nullptr) || (--table->refs > 0))
+    return;
+  OPTIONTABLE **p = &_optionTables;
+  while ((*p != nullptr) && (*p != table))
+    p = &(*p)->next;
+  if (*p != nullptr)
+    *p = table->next;
+  delete[] table->offsets;
+  delete[] table->data;
+  delete[] table->hashes;
+  delete table;
+}
+
+void WebConfig::setOptions(uint8_t index, OPTIONTABLE *table)
+{
+  touchSchema();
+  OPTIONTABLE *old = _description[index].options;
+  _description[index].options = table;
+  _description[index].optionCnt = (table != nullptr) ? table->count : 0;
+  releaseOptions(old);
+}
+
+// true if value is one of the options of the field
+// provided lists are searched one by one
+boolean WebConfig::hasOption(uint8_t index, const char *value)
+{
+  WebConfigOptionProvider *p = providerOf(index);
+  if (p != nullptr)
   {
-    switch (_description[i].type)
+    String option;
+    String label;
+    for (uint16_t i = 0; (*p)(i, option, label); i++)
     {
-    case INPUTPASSWORD:
-    case INPUTSELECT:
-    case INPUTDATE:
-    case INPUTTIME:
-    case INPUTRADIO:
-    case INPUTCOLOR:
-    case INPUTTEXT:
-      doc[_description[i].name] = values[i];
-      break;
-    case INPUTCHECKBOX:
-    case INPUTRANGE:
-    case INPUTNUMBER:
-      doc[_description[i].name] = values[i].toInt();
-      break;
-    case INPUTFLOAT:
-      doc[_description[i].name] = values[i].toFloat();
-      break;
+      if (option == value)
+        return true;
     }
+    return false;
+  }
+  const OPTIONTABLE *t = _description[index].options;
+  if (t == nullptr)
+    return false;
+  uint32_t h = hashString(value);
+  int16_t lo = 0;
+  int16_t hi = t->count - 1;
+  while (lo <= hi)
+  {
+    int16_t mid = (lo + hi) / 2;
+    if (t->hashes[mid].hash < h)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  // several options may have the same hash
+  for (; (lo < t->count) && (t->hashes[lo].hash == h); lo++)
+  {
+    if (strcmp(t->option(t->hashes[lo].index), value) == 0)
+      return true;
   }
-  serializeJson(doc, buffer);
-  return String(buffer);
+  return false;
 }
 
-JsonObject WebConfig::getResultsJson()
+// check a value against the length limit and the rule of the field type
+// returns false if value is invalid
+boolean WebConfig::validateValue(uint8_t index, String &value)
 {
-  JsonObject doc;
-  for (uint8_t i = 0; i < Staticindex; i++)
+  const WebConfigType *t = typeOf(_description[index].type);
+  if (value.length() > _description[index].maxLength)
+    return false;
+  return (t->validate == nullptr) || t->validate(*this, index, value);
+}
+
+//************************** field types *************************************
+// every type supplies its codecs through a WebConfigType, the built-in
+// types use the private members of WebConfig
+
+struct WebConfigTypes
+{
+  static const WebConfigType builtin[INPUTTYPES];
+
+  // integers are clamped to min and max
+  static boolean validateNumber(WebConfig &conf, uint8_t index, String &value)
   {
-    switch (_description[i].type)
+    const DESCRIPTION &d = conf._description[index];
+    long n;
+    char num[NUMBERLENGTH];
+    if (!parseInteger(value.c_str(), n))
+      return false;
+    if ((n < d.min) || (n > d.max))
     {
-    case INPUTPASSWORD:
-    case INPUTSELECT:
-    case INPUTDATE:
-    case INPUTTIME:
-    case INPUTRADIO:
-    case INPUTCOLOR:
-    case INPUTTEXT:
-      doc[_description[i].name] = values[i];
-      break;
-    case INPUTCHECKBOX:
-    case INPUTRANGE:
-    case INPUTNUMBER:
-      doc[_description[i].name] = values[i].toInt();
-      break;
-    case INPUTFLOAT:
-      doc[_description[i].name] = values[i].toFloat();
-      break;
+      formatInteger(num, (n < d.min) ? d.min : d.max);
+      value = num;
     }
+    return true;
   }
-  return doc;
-}
 
-// Ser values from a JSON string
-void WebConfig::setValues(String json)
-{
-  int val;
-  float fval;
-  char sval[255];
-  DeserializationError error;
-  StaticJsonDocument<1000> doc;
-  error = deserializeJson(doc, json);
-  if (error)
+  // stored as the shortest text of the number, which is also valid JSON
+  static boolean validateFloat(WebConfig &conf, uint8_t index, String &value)
   {
-    Serial.print("JSON: ");
-    Serial.println(error.c_str());
+    char num[NUMBERLENGTH];
+    double v;
+    if (!parseNumber(value.c_str(), v))
+      return false;
+    formatDouble(num, v);
+    if (value != num)
+      value = num;
+    return true;
   }
-  else
+
+  static boolean validateCheckbox(WebConfig &conf, uint8_t index, String &value)
   {
-    for (uint8_t i = 0; i < Staticindex; i++)
+    value = ((value == "0") || (value == "")) ? "0" : "1";
+    return true;
+  }
+
+  // options may be added later, without options every value is accepted
+  static boolean validateOption(WebConfig &conf, uint8_t index, String &value)
+  {
+    return ((conf._description[index].optionCnt == 0) && (conf.providerOf(index) == nullptr)) ||
+           conf.hasOption(index, value.c_str());
+  }
+
+  // one character 0 or 1 per option
+  static boolean validateMulti(WebConfig &conf, uint8_t index, String &value)
+  {
+    uint8_t cnt = conf._description[index].optionCnt;
+    // more characters than options are no valid value
+    if ((cnt > 0) && (value.length() > cnt))
+      return false;
+    for (size_t i = 0; i < value.length(); i++)
     {
-      if (doc.containsKey(_description[i].name))
-      {
-        switch (_description[i].type)
-        {
-        case INPUTPASSWORD:
-        case INPUTSELECT:
-        case INPUTDATE:
-        case INPUTTIME:
-        case INPUTRADIO:
-        case INPUTCOLOR:
-        case INPUTTEXT:
-          strlcpy(sval, doc[_description[i].name], 255);
-          values[i] = String(sval);
-          break;
-        case INPUTCHECKBOX:
-        case INPUTRANGE:
-        case INPUTNUMBER:
-          val = doc[_description[i].name];
-          values[i] = String(val);
-          break;
-        case INPUTFLOAT:
-          fval = doc[_description[i].name];
-          values[i] = String(fval);
-          break;
-        }
-      }
+      if ((value[i] != '0') && (value[i] != '1'))
+        return false;
     }
+    while (value.length() < cnt)
+      value += '0';
+    return true;
   }
-}
 
-const char *WebConfig::getValue(const char *name)
-{
-  int16_t index;
-  index = getIndex(name);
-  if (index < 0)
+  static boolean validateDate(WebConfig &conf, uint8_t index, String &value)
   {
-    return "";
+    return (value.length() == 0) || matchPattern(value.c_str(), "9999-99-99");
   }
-  else
+
+  static boolean validateTime(WebConfig &conf, uint8_t index, String &value)
   {
-    return values[index].c_str();
+    return (value.length() == 0) || matchPattern(value.c_str(), "99:99") || matchPattern(value.c_str(), "99:99:99");
   }
-}
 
-int WebConfig::getInt(const char *name)
-{
-#if defined(ESP32)
-  if (isNVS)
+  static boolean validateColor(WebConfig &conf, uint8_t index, String &value)
   {
-    return getStringNVS(name).toInt();
+    return matchPattern(value.c_str(), "#xxxxxx");
   }
-  else
-#endif
-    return getString(name).toInt();
-}
 
-float WebConfig::getFloat(const char *name)
-{
-#if defined(ESP32)
+  // title followed by one part per option
+  static boolean radioPart(WebConfig &conf, uint8_t index, uint16_t step)
+  {
+    WebConfigOptionProvider *p = conf.providerOf(index);
+    String value;
+    String label;
+    if (p != nullptr)
+      return (step == 0) || (*p)(step - 1, value, label);
+    return step < conf._description[index].optionCnt + 1;
+  }
 
-  if (isNVS)
+  // start tag, one part per option and the end tag
+  static boolean selectPart(WebConfig &conf, uint8_t index, uint16_t step)
   {
-    return getStringNVS(name).toFloat();
+    WebConfigOptionProvider *p = conf.providerOf(index);
+    String value;
+    String label;
+    if (p != nullptr)
+      return (step <= 1) || (*p)(step - 2, value, label);
+    return step < conf._description[index].optionCnt + 2;
   }
-  else
-#endif
 
-    return getString(name).toFloat();
+  static boolean multiPart(WebConfig &conf, uint8_t index, uint16_t step)
+  {
+    return step < conf._description[index].optionCnt + 2;
+  }
+
+  static void renderTextarea(WebConfig &conf, uint8_t index, uint16_t step, const char *value, WebConfigWriter &out)
+  {
+    createTextarea(out, conf._description[index], value);
+  }
+
+  static void renderNumber(WebConfig &conf, uint8_t index, uint16_t step, const char *value, WebConfigWriter &out)
+  {
+    createNumber(out, conf._description[index], value);
+  }
+
+  static void renderRange(WebConfig &conf, uint8_t index, uint16_t step, const char *value, WebConfigWriter &out)
+  {
+    createRange(out, conf._description[index], value);
+  }
+
+  static void renderCheckbox(WebConfig &conf, uint8_t index, uint16_t step, const char *value, WebConfigWriter &out)
+  {
+    createCheckbox(out, conf._description[index], value);
+  }
+
+  static void renderRadio(WebConfig &conf, uint8_t index, uint16_t step, const char *value, WebConfigWriter &out)
+  {
+    const DESCRIPTION &d = conf._description[index];
+    String option;
+    String label;
+    if (step == 0)
+      out.printTemplate(HTML_ENTRY_RADIO_TITLE, d.label);
+    else if (conf.getOption(index, step - 1, option, label))
+      createRadio(out, d.name, option.c_str(), label.c_str(), value);
+  }
+
+  static void renderSelect(WebConfig &conf, uint8_t index, uint16_t step, const char *value, WebConfigWriter &out)
+  {
+    String option;
+    String label;
+    if (step == 0)
+      startSelect(out, conf._description[index]);
+    else if (conf.getOption(index, step - 1, option, label))
+      addSelectOption(out, option.c_str(), label.c_str(), value);
+    else
+      out.print_P(HTML_ENTRY_SELECT_END);
+  }
+
+  static void renderMulti(WebConfig &conf, uint8_t index, uint16_t step, const char *value, WebConfigWriter &out)
+  {
+    const DESCRIPTION &d = conf._description[index];
+    if (step == 0)
+      startMulti(out, d);
+    else if (step <= d.optionCnt)
+      addMultiOption(out, d.name, step - 1, d.options->label(step - 1), value);
+    else
+      out.print_P(HTML_ENTRY_MULTI_END);
+  }
+};
+
+// the built-in types in the order of their numbers INPUTTEXT ... INPUTMULTICHECK
+const WebConfigType WebConfigTypes::builtin[INPUTTYPES] = {
+    {"text", "text", STORE_STRING, STORE_STRING, POST_VALUE, nullptr, nullptr, nullptr},
+    {"password", "password", STORE_STRING, STORE_STRING, POST_VALUE, nullptr, nullptr, nullptr},
+    {"number", "number", STORE_INT, STORE_INT, POST_VALUE, validateNumber, nullptr, renderNumber},
+    {"date", "date", STORE_STRING, STORE_STRING, POST_VALUE, validateDate, nullptr, nullptr},
+    {"time", "time", STORE_STRING, STORE_STRING, POST_VALUE, validateTime, nullptr, nullptr},
+    {"range", "range", STORE_INT, STORE_INT, POST_VALUE, validateNumber, nullptr, renderRange},
+    {"check", "checkbox", STORE_INT, STORE_INT, POST_CHECKED, validateCheckbox, nullptr, renderCheckbox},
+    {"radio", "radio", STORE_STRING, STORE_STRING, POST_VALUE, validateOption, radioPart, renderRadio},
+    {"select", "", STORE_STRING, STORE_STRING, POST_VALUE, validateOption, selectPart, renderSelect},
+    {"color", "color", STORE_STRING, STORE_STRING, POST_VALUE, validateColor, nullptr, nullptr},
+    {"float", "text", STORE_FLOAT, STORE_FLOAT, POST_VALUE, validateFloat, nullptr, nullptr},
+    {"textarea", "", STORE_STRING, STORE_STRING, POST_VALUE, nullptr, nullptr, renderTextarea},
+    {"multicheck", "checkbox", STORE_STRING, STORE_STRING, POST_INDICES, validateMulti, multiPart, renderMulti}};
+
+const WebConfigType *WebConfig::_types[MAXTYPES];
+uint8_t WebConfig::_typeCnt = 0;
+
+// codecs of a type number, unknown types are text fields
+const WebConfigType *WebConfig::typeOf(uint8_t type)
+{
+  if (type < INPUTTYPES)
+    return &WebConfigTypes::builtin[type];
+  if (type < INPUTTYPES + _typeCnt)
+    return _types[type - INPUTTYPES];
+  return &WebConfigTypes::builtin[INPUTTEXT];
 }
 
-boolean WebConfig::getBool(const char *name)
+// number of the type with name, INPUTTEXT if there is no such type
+uint8_t WebConfig::findType(const char *name)
 {
-#if defined(ESP32)
-  if (isNVS)
+  for (uint8_t t = 0; t < INPUTTYPES + _typeCnt; t++)
   {
-    return getStringNVS(name) != "0";
+    if (strcmp(name, typeOf(t)->name) == 0)
+      return t;
   }
-  else
-#endif
-
-    return (getString(name) != "0");
+  return INPUTTEXT;
 }
 
-// get the accesspoint name
-const char *WebConfig::getDeviceName()
+// register a field type, returns its number or 0xFF if there is no space
+uint8_t WebConfig::addType(const WebConfigType *type)
 {
-  return _deviceNAme.c_str();
+  if (_typeCnt >= MAXTYPES)
+  {
+    Serial.printf("Too many types, %s not added\n", type->name);
+    return 0xFF;
+  }
+  _types[_typeCnt] = type;
+  return INPUTTYPES + _typeCnt++;
 }
-// get the number of parameters
-uint8_t WebConfig::getCount()
+
+// description of a field, nullptr if index is out of range
+const DESCRIPTION *WebConfig::getDescription(uint8_t index)
 {
-  return Staticindex;
+  return (index < Staticindex) ? &_description[index] : nullptr;
 }
 
-// get the name of a parameter
-String WebConfig::getName(uint8_t index)
+// deliver the changed fields to the observers and clear the change set
+void WebConfig::dispatchChanges()
 {
-  if (index < Staticindex)
+  if (!_changes.any())
+    return;
+  // copy first, callbacks may change values again
+  WebConfigChanges changes = _changes;
+  _changes.clear();
+  if (_onSaveChanges)
+    _onSaveChanges(changes);
+  for (OBSERVER *o = _observers; o != nullptr; o = o->next)
   {
-    return String(_description[index].name);
+    if (changes.contains(o->index))
+      o->callback(_description[o->index].name, String(valueOf(o->index)));
   }
-  else
+}
+
+boolean WebConfigChanges::any() const
+{
+  for (uint8_t i = 0; i < sizeof(_bits); i++)
   {
-    return "";
+    if (_bits[i] != 0)
+      return true;
   }
+  return false;
 }
 
-// set the value for a parameter
-void WebConfig::setValue(const char *name, String value)
+uint8_t WebConfigChanges::count() const
 {
-  int16_t i = getIndex(name);
-  if (i >= 0)
-    values[i] = value;
+  uint8_t cnt = 0;
+  for (uint8_t i = 0; i < MAXVALUES; i++)
+  {
+    if (contains(i))
+      cnt++;
+  }
+  return cnt;
 }
 
 // set the label for a parameter
@@ -1096,14 +4381,24 @@ void WebConfig::setLabel(const char *name, const char *label)
 {
   int16_t i = getIndex(name);
   if (i >= 0)
+  {
+    lock();
     strlcpy(_description[i].label, label, LABELLENGTH);
+    touchSchema();
+    unlock();
+  }
 }
 
 // remove all options
 void WebConfig::clearOptions(uint8_t index)
 {
   if (index < Staticindex)
-    _description[index].optionCnt = 0;
+  {
+    lock();
+    setOptions(index, nullptr);
+    setOptionProvider(index, nullptr);
+    unlock();
+  }
 }
 
 void WebConfig::clearOptions(const char *name)
@@ -1119,30 +4414,49 @@ void WebConfig::addOption(uint8_t index, String option)
   addOption(index, option, option);
 }
 
+// option tables may be shared, a changed list gets its own table
 void WebConfig::addOption(uint8_t index, String option, String label)
 {
-  if (index < Staticindex)
+  // the option tables are shared by all instances
+  lock();
+  if ((index < Staticindex) && (_description[index].optionCnt < MAXOPTIONS))
   {
-    if (_description[index].optionCnt < MAXOPTIONS)
+    const char *opts[MAXOPTIONS];
+    const char *labs[MAXOPTIONS];
+    const OPTIONTABLE *t = _description[index].options;
+    uint8_t cnt = _description[index].optionCnt;
+    for (uint8_t j = 0; j < cnt; j++)
     {
-      _description[index].options[_description[index].optionCnt] = option;
-      _description[index].labels[_description[index].optionCnt] = label;
-      _description[index].optionCnt++;
+      opts[j] = t->option(j);
+      labs[j] = t->label(j);
     }
+    opts[cnt] = option.c_str();
+    labs[cnt] = label.c_str();
+    setOptions(index, internOptions(opts, labs, cnt + 1));
   }
+  unlock();
 }
 
 // modify an option
 void WebConfig::setOption(uint8_t index, uint8_t option_index, String option, String label)
 {
-  if (index < Staticindex)
+  lock();
+  if ((index < Staticindex) && (option_index < _description[index].optionCnt))
   {
-    if (option_index < _description[index].optionCnt)
+    const char *opts[MAXOPTIONS];
+    const char *labs[MAXOPTIONS];
+    const OPTIONTABLE *t = _description[index].options;
+    uint8_t cnt = _description[index].optionCnt;
+    for (uint8_t j = 0; j < cnt; j++)
     {
-      _description[index].options[option_index] = option;
-      _description[index].labels[option_index] = label;
+      opts[j] = t->option(j);
+      labs[j] = t->label(j);
     }
+    opts[option_index] = option.c_str();
+    labs[option_index] = label.c_str();
+    setOptions(index, internOptions(opts, labs, cnt));
   }
+  unlock();
 }
 
 void WebConfig::setOption(char *name, uint8_t option_index, String option, String label)
@@ -1152,6 +4466,79 @@ void WebConfig::setOption(char *name, uint8_t option_index, String option, Strin
     setOption(i, option_index, option, label);
 }
 
+// set or remove the option provider of a select or radio field
+boolean WebConfig::setOptionProvider(uint8_t index, WebConfigOptionProvider provider)
+{
+  if ((index >= Staticindex) ||
+      ((provider != nullptr) && (_description[index].type != INPUTSELECT) && (_description[index].type != INPUTRADIO)))
+    return false;
+  lock();
+  PROVIDER **p = &_providers;
+  while ((*p != nullptr) && ((*p)->index != index))
+    p = &(*p)->next;
+  if (provider == nullptr)
+  {
+    if (*p != nullptr)
+    {
+      PROVIDER *old = *p;
+      *p = old->next;
+      delete old;
+    }
+  }
+  else
+  {
+    if (*p == nullptr)
+    {
+      *p = new PROVIDER;
+      (*p)->index = index;
+      (*p)->next = nullptr;
+    }
+    (*p)->provider = provider;
+  }
+  touchSchema();
+  unlock();
+  return true;
+}
+
+boolean WebConfig::setOptionProvider(const char *name, WebConfigOptionProvider provider)
+{
+  int16_t i = getIndex(name);
+  return (i >= 0) && setOptionProvider(i, provider);
+}
+
+WebConfigOptionProvider *WebConfig::providerOf(uint8_t index)
+{
+  for (PROVIDER *p = _providers; p != nullptr; p = p->next)
+  {
+    if (p->index == index)
+      return &p->provider;
+  }
+  return nullptr;
+}
+
+// get an option from the provider or the option table, provided
+// options are cut to fit into the output buffer
+boolean WebConfig::getOption(uint8_t index, uint16_t option, String &value, String &label)
+{
+  WebConfigOptionProvider *p = providerOf(index);
+  if (p != nullptr)
+  {
+    if (!(*p)(option, value, label))
+      return false;
+    if (value.length() > PROVIDERLENGTH)
+      value.remove(PROVIDERLENGTH);
+    if (label.length() > PROVIDERLENGTH)
+      label.remove(PROVIDERLENGTH);
+    return true;
+  }
+  const OPTIONTABLE *t = _description[index].options;
+  if (option >= _description[index].optionCnt)
+    return false;
+  value = t->option(option);
+  label = t->label(option);
+  return true;
+}
+
 // get the options count
 uint8_t WebConfig::getOptionCount(uint8_t index)
 {
@@ -1182,6 +4569,7 @@ uint8_t WebConfig::getOptionCount(char *name)
 void WebConfig::setButtons(uint8_t buttons)
 {
   _buttons = buttons;
+  touchSchema();
 }
 // register onSave callback
 void WebConfig::registerOnSave(std::function<void(String)> callback)
@@ -1196,6 +4584,28 @@ void WebConfig::registerOnSave(std::function<void()> callback)
 {
   _onSave_null = callback;
 }
+void WebConfig::registerOnSaveChanges(std::function<void(const WebConfigChanges &)> callback)
+{
+  _onSaveChanges = callback;
+}
+// register a callback for changes of a single field
+boolean WebConfig::registerOnChange(const char *name, WebConfigObserver callback)
+{
+  int16_t i = getIndex(name);
+  if (i < 0)
+    return false;
+  OBSERVER *o = new OBSERVER;
+  o->index = i;
+  o->callback = callback;
+  o->next = _observers;
+  _observers = o;
+  return true;
+}
+// fields changed since the last save event
+const WebConfigChanges &WebConfig::getChanges()
+{
+  return _changes;
+}
 // register onSave callback
 void WebConfig::registerOnDone(void (*callback)(String results))
 {
@@ -1211,3 +4621,94 @@ void WebConfig::registerOnDelete(void (*callback)(String name))
 {
   _onDelete = callback;
 }
+
+//*************************** memory *****************************************
+void WebConfig::setAllocationCounter(std::function<uint32_t()> counter)
+{
+  _allocationCounter = counter;
+}
+
+uint32_t WebConfig::allocations()
+{
+  return _allocationCounter ? _allocationCounter() : 0;
+}
+
+// characters of a string, an empty string has no buffer
+static size_t stringSize(const String &s)
+{
+  return (s.length() > 0) ? s.length() + 1 : 0;
+}
+
+// estimated RAM used by the instance. Strings are counted with their
+// length, the allocator and the capacity of a String may reserve more.
+// Not counted are a storage backend passed by the sketch, the data held
+// by a backend, the web server and the state of running requests
+WebConfigFootprint WebConfig::getFootprint()
+{
+  WebConfigFootprint f;
+  memset(&f, 0, sizeof(f));
+  lock();
+  f.object = sizeof(WebConfig);
+  f.descriptions = _descriptionCap * sizeof(DESCRIPTION);
+  for (uint8_t i = 0; i < Staticindex; i++)
+  {
+    f.values += stringSize(values[i]);
+    f.defaults += strlen(_defaults[i]) + 1;
+    // a table used by several fields is counted once
+    OPTIONTABLE *t = _description[i].options;
+    boolean counted = false;
+    for (uint8_t j = 0; (t != nullptr) && (j < i) && !counted; j++)
+      counted = _description[j].options == t;
+    if ((t != nullptr) && !counted && (t->count > 0))
+    {
+      f.options += sizeof(OPTIONTABLE) + t->count * (2 * sizeof(uint16_t) + sizeof(OPTIONHASH)) +
+                   t->offsets[2 * t->count - 1] + strlen(t->label(t->count - 1)) + 1;
+    }
+  }
+  for (DEFAULTBLOCK *b = _defaultBlocks; b != nullptr; b = b->next)
+    f.defaults += sizeof(DEFAULTBLOCK);
+  for (PROFILE *p = _profiles; p != nullptr; p = p->next)
+  {
+    f.profiles += sizeof(PROFILE);
+    for (uint8_t i = 0; i < Staticindex; i++)
+      f.profiles += stringSize(p->values[i]);
+  }
+  for (OBSERVER *o = _observers; o != nullptr; o = o->next)
+    f.callbacks += sizeof(OBSERVER);
+  for (PROVIDER *p = _providers; p != nullptr; p = p->next)
+    f.callbacks += sizeof(PROVIDER);
+  for (SUBSCRIBER *s = _subscribers; s != nullptr; s = s->next)
+    f.callbacks += sizeof(SUBSCRIBER);
+  f.strings = stringSize(_deviceNAme) + stringSize(_uri) + stringSize(_title) + stringSize(_storedProfile);
+  if (_results != nullptr)
+    f.results = sizeof(DynamicJsonDocument) + _results->capacity();
+  if (_ownStorage)
+  {
+#if defined(ESP32)
+    f.backends += isNVS ? sizeof(NVSStorage) : sizeof(LittleFSStorage);
+#elif defined(ESP8266)
+    f.backends += sizeof(LittleFSStorage);
+#else
+    f.backends += sizeof(RAMStorage);
+#endif
+  }
+#if defined(WEBCONFIG_WEBSERVER)
+  if (_serverTransport != nullptr)
+    f.backends += sizeof(WebServerTransport);
+#endif
+  f.renderAllocs = _renderAllocs;
+  f.saveAllocs = _saveAllocs;
+  unlock();
+  return f;
+}
+
+void WebConfig::printFootprint()
+{
+  WebConfigFootprint f = getFootprint();
+  Serial.printf("WebConfig RAM about %u bytes: object %u, heap %u (descriptions %u, values %u, options %u, defaults %u, profiles %u, "
+                "callbacks %u, strings %u, results %u, backends %u)\n",
+                (unsigned)f.total(), (unsigned)f.object, (unsigned)f.heap(), (unsigned)f.descriptions, (unsigned)f.values,
+                (unsigned)f.options, (unsigned)f.defaults, (unsigned)f.profiles, (unsigned)f.callbacks, (unsigned)f.strings,
+                (unsigned)f.results, (unsigned)f.backends);
+  Serial.printf("allocations: render %u, save %u\n", (unsigned)f.renderAllocs, (unsigned)f.saveAllocs);
+}
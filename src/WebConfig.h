@@ -21,23 +21,34 @@ Dependencies:
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
-
-#if defined(ESP32)
-#include <WebServer.h>
-#else
-#include <ESP8266WebServer.h>
-#endif
+#include <memory>
+#include "WebConfigTransport.h"
+#include "WebConfigStorage.h"
+#include "WebConfigOptions.h"
+#include "WebConfigNumber.h"
 
 //maximum number of parameters
 #define MAXVALUES 20
 
+//maximum number of sections of a form
+#define MAXSECTIONS 8
+
+//maximum number of profiles and length of their names
+#define MAXPROFILES 8
+#define PROFILENAMELENGTH 12
+//maximum number of open event streams
+#define MAXSUBSCRIBERS 4
+//interval of keep alive comments on idle event streams in ms
+#define EVENTKEEPALIVE 15000
 //maximum number of options per parameters
 #define MAXOPTIONS 15
 
 //character limits
 #define NAMELENGTH 20
-#define NVS_NAMELENGTH 15
 #define LABELLENGTH 40
+//default limit for the length of a value, "maxlen" in the description
+//sets it per field
+#define WEBCONFIG_MAXLENGTH 4096
 
 //name for the config file
 #define CONFFILE "/WebConf.conf"
@@ -59,13 +70,49 @@ Dependencies:
 #define OPTION_INPUTMULTICHECK "12"
 
 
-//number of types
+//number of built-in types
 #define INPUTTYPES 13
+//maximum number of types added with addType()
+#define MAXTYPES 8
+
+//how a field is posted by the form
+#define POST_VALUE 0
+//checkbox, present if checked
+#define POST_CHECKED 1
+//multiple checkboxes, one argument with the option index per checked box
+#define POST_INDICES 2
 
 #define BTN_CONFIG 0
 #define BTN_DONE 1
 #define BTN_CANCEL 2
 #define BTN_DELETE 4
+
+//binary encodings of writeResults() and readValues()
+#define RESULTS_MSGPACK 0
+#define RESULTS_CBOR 1
+
+//hash of an option value and its position in the option table
+typedef struct {
+  uint32_t hash;
+  uint8_t index;
+} OPTIONHASH;
+
+//list of option values and labels. Identical lists are stored once and
+//shared by all fields using them, a shared table is never modified
+struct OPTIONTABLE {
+  uint32_t hash;
+  uint8_t refs;
+  uint8_t count;
+  //offsets of value and label of every option in data
+  uint16_t* offsets;
+  char* data;
+  //option values sorted by hash for the validation
+  OPTIONHASH* hashes;
+  OPTIONTABLE* next;
+  const char* option(uint8_t index) const { return data + offsets[2 * index]; }
+  const char* label(uint8_t index) const { return data + offsets[2 * index + 1]; }
+};
+
 //data structure to hold the parameter Description
 typedef //Struktur eines Datenpakets
 struct {
@@ -75,32 +122,183 @@ struct {
   int min;
   int max;
   uint8_t optionCnt;
-  String options[MAXOPTIONS];
-  String labels[MAXOPTIONS];
+  OPTIONTABLE* options = nullptr;
+  //section of the field, 0 = none
+  uint8_t section = 0;
+  //maximum length of the value, longer values are rejected
+  uint16_t maxLength = WEBCONFIG_MAXLENGTH;
 } DESCRIPTION;
 
+//set of changed fields, one bit per field index
+class WebConfigChanges {
+  public:
+  WebConfigChanges() { clear(); }
+  void clear() { memset(_bits, 0, sizeof(_bits)); }
+  void clear(uint8_t index) { if (index < MAXVALUES) _bits[index >> 3] &= ~(1 << (index & 7)); }
+  void set(uint8_t index) { if (index < MAXVALUES) _bits[index >> 3] |= (1 << (index & 7)); }
+  boolean contains(uint8_t index) const { return (index < MAXVALUES) && (_bits[index >> 3] & (1 << (index & 7))); }
+  boolean any() const;
+  uint8_t count() const;
+  private:
+  uint8_t _bits[(MAXVALUES + 7) / 8];
+};
+
+//estimated RAM of an instance in bytes, see getFootprint(). Strings are
+//counted with their length, not with the capacity the allocator reserved
+typedef struct {
+  //the instance itself with values[] and the fixed arrays
+  size_t object;
+  //heap
+  size_t descriptions;
+  //characters of the value strings including the terminating zero
+  size_t values;
+  //option tables used by the fields, shared tables are counted fully
+  size_t options;
+  size_t defaults;
+  //profiles with the copies of their values
+  size_t profiles;
+  //observers, option providers and event streams
+  size_t callbacks;
+  //device name, uri, title and name of the stored profile
+  size_t strings;
+  //document kept by getResultsJson()
+  size_t results;
+  //objects of the storage backend and the transport created by the
+  //instance, not the data a backend holds
+  size_t backends;
+  //allocations of the last form render and the last save, 0 without
+  //allocation counter
+  uint32_t renderAllocs;
+  uint32_t saveAllocs;
+  size_t heap() const { return descriptions + values + options + defaults + profiles + callbacks + strings + results + backends; }
+  size_t total() const { return object + heap(); }
+} WebConfigFootprint;
+
+//subscription for changes of a single field
+typedef std::function<void(const char* name, const String& value)> WebConfigObserver;
+
+class WebConfig;
+
+//output of the form renderer. A part of the form is rendered again for
+//every chunk it is continued in and only the bytes from skip on are
+//copied into the buffer, so a part may be longer than the buffer
+class WebConfigWriter {
+  public:
+  WebConfigWriter(uint8_t* buffer, size_t maxLen, size_t skip) : _buffer(buffer), _maxLen(maxLen), _skip(skip) {}
+  //text from RAM, print_P() for text from PROGMEM
+  void print(const char* text);
+  void print_P(const char* text);
+  //text with & < > ' and " escaped for an element or a quoted attribute
+  void printEscaped(const char* text);
+  //text percent encoded for a query parameter, it is safe inside a
+  //quoted attribute and a JavaScript string as well
+  void printEncoded(const char* text);
+  //template from PROGMEM, %s is replaced by a string escaped like
+  //printEscaped(), %i by an int, %lu by an unsigned long and %% by %
+  void printTemplate(const char* format, ...);
+  //length of the part so far and the bytes copied into the buffer
+  size_t length() const { return _len; }
+  size_t count() const { return _cnt; }
+  private:
+  void write(char c);
+  uint8_t* _buffer;
+  size_t _maxLen;
+  size_t _skip;
+  size_t _len = 0;
+  size_t _cnt = 0;
+};
+
+//codecs of a field type. The built-in types are registered by default,
+//addType() adds new ones. Functions which are nullptr behave like a
+//text field
+typedef struct {
+  //name of the type in the JSON description
+  const char* name;
+  //type of the HTML input element, also used by the client side form
+  const char* input;
+  //kind of the value in the storage and in the results
+  //STORE_STRING, STORE_INT or STORE_FLOAT
+  uint8_t store;
+  uint8_t result;
+  //POST_VALUE, POST_CHECKED or POST_INDICES
+  uint8_t post;
+  //check a value and bring it into its stored form, false rejects it
+  boolean (*validate)(WebConfig& conf, uint8_t index, String& value);
+  //true if the field has a part step, nullptr for a single part
+  boolean (*hasPart)(WebConfig& conf, uint8_t index, uint16_t step);
+  //render part step of the field with out, nullptr for an input element
+  void (*render)(WebConfig& conf, uint8_t index, uint16_t step, const char* value, WebConfigWriter& out);
+} WebConfigType;
+
 class WebConfig {
   public:
+  //NVS = true stores the config in the NVS namespace NVSNamespace (ESP32)
+  //and loads it with the descriptions, otherwise in the file CONFFILE
   WebConfig(boolean NVS = false, const char* NVSNamespace = "default");
+  //use the storage backend storage
+  WebConfig(WebConfigStorage* storage);
+  //frees the descriptions, lists and the own storage, it must not be
+  //destroyed while a request is handled
+  ~WebConfig();
+  //an instance owns heap objects and cannot be copied
+  WebConfig(const WebConfig&) = delete;
+  WebConfig& operator=(const WebConfig&) = delete;
+  //replace the storage backend
+  void setStorage(WebConfigStorage* storage);
   //load form descriptions
-  void setDescription(String parameter, WebServer* server);
+#if defined(WEBCONFIG_WEBSERVER)
+  //serve the form at uri, several instances may be mounted on one server
+  void setDescription(String parameter, WebServer* server, const char* uri = "/");
+  //serve the list of all mounted forms at uri
+  static void setIndex(WebServer* server, const char* uri = "/");
+  //function to respond a HTTP request for the form use the filename
+  //to save.
+  void handleFormRequest(WebServer* server, const char* filename);
+  //function to respond a HTTP request for the form use the default file
+  //to save and restart ESP after saving the new config
+  void handleFormRequest(WebServer* server);
+#endif
+  //function to respond a form request received by any transport
+  void handleFormRequest(WebConfigTransport* server);
+  //list the form at uri with title on the index page
+  void mount(const char* uri, const char* title = nullptr);
+  //respond the index page with links to all mounted forms
+  static void handleIndex(WebConfigTransport* server);
   //Add extra descriptions
   void addDescription(String parameter);
+  //cache the parsed descriptions in the storage, later calls with the same
+  //schema text load the cache instead of parsing JSON
+  //must be called before setDescription()
+  void setSchemaCache(boolean enable);
+#if defined(WEBCONFIG_WEBSERVER)
   //function to respond a HTTP request for the form use the filename
   //to save.
   bool handleRoot();
+#endif
   int16_t getIndex(const char* name);
-  //read configuration from default file
+  //read configuration from the storage
   boolean readConfig();
   //write configuration to default file
+  //in write-behind mode the config is only marked dirty
   boolean writeConfig();
-  //
+  //enable write-behind mode. Changes are committed after quietMs without
+  //further changes but not later than maxDelayMs after the first change
+  //quietMs = 0 switches back to immediate writes
+  void setWriteBehind(uint32_t quietMs, uint32_t maxDelayMs = 0);
+  //drive the write-behind scheduler and the event streams, call it from loop()
+  void loop();
+  //commit pending changes immediately (e.g. before restart or deep sleep)
+  boolean flush();
+  //true if there are changes not yet committed
+  boolean isDirty();
+  //duration of the last commit to the storage in microseconds
+  uint32_t getCommitTime();
 
-  //delete configuration file
+  //delete configuration file in LittleFS
   boolean deleteConfig(const char* filename);
-  //delete default configutation file
+  //delete the stored configuration
   boolean deleteConfig();
-
+  //same as deleteConfig()
   boolean deleteConfigNVS();
 
   //get a parameter value by its name
@@ -119,12 +317,25 @@ class WebConfig {
   String getName(uint8_t index);
   //Get results as a JSON string
   String getResults();
-  //
+  //results of the profile with name
+  String getResults(const char* profile);
+  //results as JSON object, valid until the next call
   JsonObject getResultsJson();
   //Ser values from a JSON string
   void setValues(String json);
+  //write the results as MessagePack or CBOR map to out without building a
+  //document, returns the number of bytes written
+  size_t writeResults(Print& out, uint8_t format = RESULTS_MSGPACK, const char* profile = nullptr);
+  //set values from a MessagePack or CBOR map read from in like
+  //setValues(). Returns false if the data is not a map of fields
+  boolean readValues(Stream& in, uint8_t format = RESULTS_MSGPACK);
   //set the value for a parameter
   void setValue(const char* name, String value);
+  //set a parameter back to its default value
+  void resetValue(const char* name);
+  //keep only values different from the defaults in values[] and in the
+  //storage, must be called before setDescription()
+  void setCopyOnWrite(boolean enable);
   //set the label for a parameter
   void setLabel(const char* name, const char* label);
   //remove all options
@@ -136,15 +347,103 @@ class WebConfig {
   //modify an option
   void setOption(uint8_t index, uint8_t option_index, String option, String label);
   void setOption(char* name, uint8_t option_index, String option, String label);
+  //register a field type, it can be used in descriptions added later by
+  //its name or by the returned number. type has to stay valid, returns
+  //0xFF if MAXTYPES types are already added
+  static uint8_t addType(const WebConfigType* type);
+  //description of a field, nullptr if index is out of range
+  const DESCRIPTION* getDescription(uint8_t index);
   //get the options count
   uint8_t getOptionCount(uint8_t index);
   uint8_t getOptionCount(char* name);
+  //build the form in the browser. The device serves a static page, the
+  //schema and the values as JSON instead of rendering the form
+  void setClientRendering(boolean enable);
+  //add a profile with a copy of the active values. The first profile
+  //makes the values used so far the profile "default"
+  boolean addProfile(const char* name);
+  //remove a profile, not the active one
+  boolean removeProfile(const char* name);
+  //make a profile active without reading the storage
+  boolean selectProfile(const char* name);
+  //name of the active profile, empty without profiles
+  const char* getProfile();
+  uint8_t getProfileCount();
+  const char* getProfileName(uint8_t index);
+  //estimated RAM used by this instance
+  WebConfigFootprint getFootprint();
+  //print the footprint to Serial
+  void printFootprint();
+  //function returning a running count of heap allocations, e.g. from a
+  //wrapped malloc. It is sampled before and after render and save
+  static void setAllocationCounter(std::function<uint32_t()> counter);
+  //version of the values, every change of a value increments it
+  uint32_t getVersion();
+  //random number which changes with every start, versions are only
+  //comparable within the same epoch
+  uint32_t getEpoch();
+  //version of the last change of a field, 0 if it was not changed
+  uint32_t getFieldVersion(const char* name);
+  //fields changed since version as JSON, all fields if epoch does not match
+  String getChangesJson(uint32_t since, uint32_t epoch);
+  //stream the complete configuration as text blob, withHash adds the
+  //schema hash so a restore on another schema is rejected
+  void beginExport(boolean withHash = true);
+  //copy the next part of the blob into buffer, 0 at the end
+  size_t exportChunk(uint8_t* buffer, size_t maxLen);
+  //restore a blob created by the export, the blob can be passed in
+  //pieces of any size. Every restore has its own state, so the bodies
+  //of concurrent requests can be decoded at the same time
+  WebConfigImportState* beginImport();
+  boolean importChunk(WebConfigImportState* state, const uint8_t* data, size_t len);
+  //apply the restored values with one commit and free state. Nothing is
+  //changed if the blob is incomplete, a value is invalid or the schema
+  //hash differs
+  boolean endImport(WebConfigImportState* state);
+  //free a restore without applying it
+  static void discardImport(WebConfigImportState* state);
+  //decode a urlencoded form body in pieces of any size. Every field is
+  //validated and stored as soon as its value is complete, so the body is
+  //never held as a whole. server selects a section or field list like
+  //the form request, nullptr accepts all fields
+  WebConfigFormState* beginForm(WebConfigTransport* server = nullptr);
+  boolean formChunk(WebConfigFormState* state, const uint8_t* data, size_t len);
+  //finish the body and free state, checkboxes not sent are cleared
+  //returns the number of rejected values
+  uint8_t endForm(WebConfigFormState* state);
+  //free a form body which was not finished, the fields decoded so far
+  //stay stored
+  static void discardForm(WebConfigFormState* state);
+  //apply changed values in the HTML form without reloading it, the form
+  //listens to the event stream of the device. Needs loop()
+  void setLiveUpdate(boolean enable);
+  //take the options of a select or radio field from a provider, the
+  //options are requested while rendering and validating. nullptr removes it
+  boolean setOptionProvider(uint8_t index, WebConfigOptionProvider provider);
+  boolean setOptionProvider(const char* name, WebConfigOptionProvider provider);
   //set form type to doen cancel
   void setButtons(uint8_t buttons);
+  //send the form in slices of at most bytes per loop() call
+  //0 = send the whole form at once (default). Only supported on ESP32
+  void setRenderSlice(uint16_t bytes);
+  //true while a sliced form response is pending
+  boolean isRendering();
+  //start rendering the form, the result is fetched with renderChunk()
+  void beginRender(boolean saved = false, boolean errorSaving = false);
+  //copy the next part of the form into buffer, at most maxLen bytes
+  //returns the number of bytes, 0 if the form is complete
+  size_t renderChunk(uint8_t* buffer, size_t maxLen);
   //register onSave callback
   void registerOnSave(std::function<void(String)>);
   void registerOnSave(std::function<void(JsonObject)>);
   void registerOnSave(std::function<void()>callback);
+  //register onSave callback receiving only the set of changed fields
+  void registerOnSaveChanges(std::function<void(const WebConfigChanges&)> callback);
+  //register a callback for changes of the field with name name
+  //several callbacks per field are possible
+  boolean registerOnChange(const char* name, WebConfigObserver callback);
+  //fields changed since the last save event
+  const WebConfigChanges& getChanges();
   //register onSave callback
   void registerOnDone(void (*callback)(String results));
   //register onSave callback
@@ -153,43 +452,237 @@ class WebConfig {
   void registerOnDelete(void (*callback)(String name));
 
   //values for the parameter
+  //with copy on write only overridden values, use getValue() to read
   String values[MAXVALUES];
   private:
   const boolean isNVS;
-  char _buf[1000];
+  //mounted instances for the index page
+  static WebConfig* _instances;
+  static boolean indexPart(WebConfigWriter& out, uint16_t part);
+  WebConfig* _nextInstance = nullptr;
+  String _uri;
+  String _title;
+#if defined(WEBCONFIG_WEBSERVER)
   WebServer* _server{ nullptr };
-  uint8_t Staticindex;
+#endif
+  uint8_t Staticindex = 0;
   String _deviceNAme;
-  String nameSpace;
+  WebConfigStorage* _storage = nullptr;
+  boolean _ownStorage = false;
   uint8_t _buttons = BTN_CONFIG;
-  DESCRIPTION _description[MAXVALUES];
+  //descriptions, grown to the number of fields
+  DESCRIPTION* _description = nullptr;
+  uint8_t _descriptionCap = 0;
+  void reserveDescriptions(uint8_t count);
   std::function<void(String)> _onSave{ nullptr };
   std::function<void()> _onSave_null{ nullptr };
   std::function<void(JsonObject)> _onSaveJson{ nullptr };
+  std::function<void(const WebConfigChanges&)> _onSaveChanges{ nullptr };
+  struct OBSERVER {
+    uint8_t index;
+    WebConfigObserver callback;
+    OBSERVER* next;
+  };
+  OBSERVER* _observers = nullptr;
+  //option providers of large selection lists
+  struct PROVIDER {
+    uint8_t index;
+    WebConfigOptionProvider provider;
+    PROVIDER* next;
+  };
+  PROVIDER* _providers = nullptr;
+  WebConfigOptionProvider* providerOf(uint8_t index);
+  //option of a field from the table or the provider
+  boolean getOption(uint8_t index, uint16_t option, String& value, String& label);
+  WebConfigChanges _changes;
   void (*_onDone)(String results) = NULL;
   void (*_onCancel)() = NULL;
   void (*_onDelete)(String name) = NULL;
-  boolean writeConfig(const char* filename);
-
+  boolean _dirty = false;
+  uint32_t _commitTime = 0;
+  uint32_t _wbQuiet = 0;
+  uint32_t _wbMaxDelay = 0;
+  uint32_t _firstChange = 0;
+  uint32_t _lastChange = 0;
+  //every change of a value gets the next version, the epoch changes
+  //with every start so versions of a former run are recognized
+  uint32_t _version = 0;
+  uint32_t _epoch = 0;
+  uint32_t _fieldVersion[MAXVALUES];
+  uint32_t _nameVersion = 0;
+  //apply a batch of changes with optimistic concurrency
+  void applyChanges(WebConfigTransport* server);
+  //state of a backup stream, one per response
+  typedef struct {
+    uint8_t item;
+    size_t pos;
+    boolean withHash;
+  } EXPORTSTATE;
+  EXPORTSTATE _export;
+  void beginExport(EXPORTSTATE& state, boolean withHash);
+  size_t exportChunk(EXPORTSTATE& state, uint8_t* buffer, size_t maxLen);
+  boolean exportItem(struct EXPORTWRITER& w, uint8_t item, boolean withHash);
+  void importLine(WebConfigImportState* s);
+  void restoreConfig(WebConfigTransport* server);
+  void formName(WebConfigFormState* s);
+  void formField(WebConfigFormState* s);
+  uint8_t endForm(WebConfigFormState* s, uint8_t& buttons);
+  uint8_t pressedButtons(WebConfigTransport* server);
+  //open event streams
+  struct SUBSCRIBER {
+    WebConfigEventStream* stream;
+    uint32_t version;
+    uint32_t lastSend;
+    SUBSCRIBER* next;
+  };
+  SUBSCRIBER* _subscribers = nullptr;
+  uint8_t _subscriberCnt = 0;
+  void openEvents(WebConfigTransport* server);
+  void dispatchEvents();
+  //profiles, the active profile uses values[]
+  struct PROFILE {
+    char name[PROFILENAMELENGTH];
+    String values[MAXVALUES];
+    WebConfigChanges overridden;
+    //the blob of the profile has to be written
+    boolean dirty;
+    PROFILE* next;
+  };
+  PROFILE* _profiles = nullptr;
+  PROFILE* _activeProfile = nullptr;
+  uint8_t _profileCnt = 0;
+  boolean _profileListDirty = false;
+  //name of the profile whose values are in the config, read with it
+  String _storedProfile;
+  //only a profile switch is pending, the config entries are unchanged
+  boolean _profilesOnly = false;
+  //exchange the active values with the values of p, p becomes active
+  void swapProfile(PROFILE* p);
+  PROFILE* findProfile(const char* name);
+  PROFILE* newProfile(const char* name);
+  const char* profileValue(PROFILE* p, uint8_t index);
+  //results document sized from the values, the one of getResultsJson()
+  //is kept until the next call
+  size_t resultsCapacity(PROFILE* p);
+  void fillResults(JsonDocument& doc, PROFILE* p);
+  DynamicJsonDocument* _results = nullptr;
+  void writeProfile(struct SCHEMAWRITER& w, PROFILE* p);
+  boolean storeProfiles();
+  void loadProfiles();
+  void loadValue(String* vals, WebConfigChanges& overridden, uint8_t index, const char* value);
+  //sections, a field with a section starts it, the following fields belong to it
+  char _sections[MAXSECTIONS][NAMELENGTH];
+  uint8_t _sectionCnt = 0;
+  uint8_t findSection(const char* name);
+  uint8_t addSection(const char* name);
+  //fields selected by ?wcsection= or ?wcfields=, false for the whole form
+  boolean selectFields(WebConfigTransport* server, WebConfigChanges& fields, uint8_t& section);
+  //link with ?arg=name, the active link is bold
+  void renderLink(WebConfigWriter& out, const char* arg, const char* name, boolean active);
+  //button posting the form to ?wc=profile&name=name
+  void renderProfile(WebConfigWriter& out, const char* name);
+  //client side rendering
+  boolean _clientRendering = false;
+  boolean _liveUpdate = false;
+  uint32_t _schemaHash = 0;
+  void touchSchema();
+  void sendShell(WebConfigTransport* server);
+  void sendSchema(WebConfigTransport* server);
+  void sendValues(WebConfigTransport* server, boolean saved, boolean errorSaving, uint8_t invalid);
+  void sendOptions(WebConfigTransport* server, uint8_t index);
+  //state of the form renderer, one per response
+  enum { RS_START, RS_DEVICENAME, RS_PROFILES, RS_SECTIONS, RS_FIELDS, RS_SAVED, RS_LIVE, RS_END, RS_DONE };
+  typedef struct {
+    uint8_t stage = RS_DONE;
+    uint8_t field;
+    uint16_t step;
+    size_t pos;
+    uint8_t invalid;
+    boolean saved;
+    boolean errorSaving;
+    //allocation count at the start of the render
+    uint32_t allocs;
+    //only the selected fields of a section or a field list are rendered
+    boolean partial;
+    uint8_t section;
+    WebConfigChanges fields;
+  } RENDERSTATE;
+  RENDERSTATE _render;
+  uint16_t _renderSlice = 0;
+#if defined(WEBCONFIG_WEBSERVER)
+  WebServerTransport* _serverTransport = nullptr;
+#endif
+  void beginRender(RENDERSTATE& state, boolean saved, boolean errorSaving);
+  size_t renderChunk(RENDERSTATE& state, uint8_t* buffer, size_t maxLen);
+  //render the current part of the form with out
+  boolean renderPart(const RENDERSTATE& state, WebConfigWriter& out);
+  void nextPart(RENDERSTATE& state);
+  boolean hasPart(uint8_t index, uint16_t step);
+  void renderField(WebConfigWriter& out, uint8_t index, uint16_t step);
 #if defined(ESP32)
-  boolean writeConfigNVS();
-  void handleFormRequest(WebServer* server, const char* filename);
-  //function to respond a HTTP request for the form use the default file
-  //to save and restart ESP after saving the new config
-  void handleFormRequest(WebServer* server);
-  //get the index for a value by parameter name
-  const String getStringNVS(const char* name);
-  int getIntNVS(const char* name);
-  float getfloatNVS(const char* name);
-
-#else
-  void handleFormRequest(ESP8266WebServer* server, const char* filename);
-  //function to respond a HTTP request for the form use the default file
-  //to save and restart ESP after saving the new config
-  void handleFormRequest(ESP8266WebServer* server);
-  //get the index for a value by parameter name
+  static SemaphoreHandle_t _lock;
 #endif
+  //serialize access from the async server task and loop(), one lock for
+  //all instances because they share the option tables
+  static std::function<uint32_t()> _allocationCounter;
+  static uint32_t allocations();
+  uint32_t _renderAllocs = 0;
+  uint32_t _saveAllocs = 0;
+  static void lock();
+  static void unlock();
+  //defaults of all fields, stored in RAM in one block per addDescription()
+  struct DEFAULTBLOCK {
+    char* data;
+    DEFAULTBLOCK* next;
+  };
+  DEFAULTBLOCK* _defaultBlocks = nullptr;
+  const char* _defaults[MAXVALUES];
+  WebConfigChanges _overridden;
+  boolean _copyOnWrite = false;
+  void setDefaults(uint8_t first, const char* pool, size_t len);
+  void clearDefaults();
+  //current value of a field, the default if it was not overridden
+  const char* valueOf(uint8_t index);
+  boolean _schemaCache = false;
+  void parseDescription(const String& parameter);
+  void writeSchema(struct SCHEMAWRITER& w, uint8_t first, uint32_t hash);
+  boolean storeSchema(uint8_t first, uint32_t hash);
+  boolean loadSchema(uint8_t first, uint32_t hash);
+  //write the config to the storage now
+  boolean commitConfig();
+  //load the stored values of all fields
+  boolean loadConfig();
+  //entries for the storage, the device name and all fields
+  uint8_t configEntries(CONFIGENTRY* entries);
+  //remember a change for the write-behind scheduler
+  void markDirty();
+  //validate a value and set it, mark the config dirty if it has changed
+  boolean updateValue(uint8_t index, String value);
+  //pool of the option tables of all fields of all instances
+  static OPTIONTABLE* _optionTables;
+  //find or create the table for count options, the table is referenced once more
+  OPTIONTABLE* internOptions(const char* const* options, const char* const* labels, uint8_t count);
+  void releaseOptions(OPTIONTABLE* table);
+  //assign a table to a field and release the previous one
+  void setOptions(uint8_t index, OPTIONTABLE* table);
+  //field types, the built-in types followed by the added ones
+  friend struct WebConfigTypes;
+  static const WebConfigType* _types[MAXTYPES];
+  static uint8_t _typeCnt;
+  static const WebConfigType* typeOf(uint8_t type);
+  static uint8_t findType(const char* name);
+  boolean validateValue(uint8_t index, String& value);
+  boolean hasOption(uint8_t index, const char* value);
+  static uint32_t hashString(const char* s, uint32_t h = 2166136261UL);
+  //deliver the changed fields to the observers and clear the change set
+  void dispatchChanges();
+
 
 };
 
+//compile time check of the static RAM of count instances, e.g.
+//WEBCONFIG_ASSERT_BUDGET(2, 8192); in the sketch
+#define WEBCONFIG_ASSERT_BUDGET(count, bytes) \
+  static_assert((count) * sizeof(WebConfig) <= (bytes), "WebConfig exceeds the RAM budget")
+
 #endif
@@ -0,0 +1,219 @@
+/*
+
+File WebConfigAsync.h
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+
+Description
+Adapter to serve a WebConfig form with ESPAsyncWebServer.
+The request arguments are parsed by the server task, the form is sent
+as chunked response pulled by the server. Nothing blocks loop().
+Saving from the server task should be combined with write-behind mode,
+so flash is written by loop() and not while the server task waits.
+
+Dependencies:
+  ESPAsyncWebServer.h
+
+Include ESPAsyncWebServer.h and this file in the sketch, WebConfig
+itself does not depend on ESPAsyncWebServer.
+
+*/
+#ifndef WebConfigAsync_h
+#define WebConfigAsync_h
+
+#include <ESPAsyncWebServer.h>
+#include <WebConfig.h>
+
+//maximum number of headers of one response
+#define ASYNC_MAXHEADERS 4
+
+//events queued for a chunked response, the server task pulls them
+typedef struct {
+  String pending;
+  boolean connected;
+#if defined(ESP32)
+  SemaphoreHandle_t lock;
+#endif
+} ASYNCEVENTS;
+
+//decoder states of the body of one request, kept in _tempObject of the
+//request which is released with free()
+typedef struct {
+  WebConfigFormState* form;
+  WebConfigImportState* import;
+} ASYNCBODY;
+
+class AsyncWebConfigEventStream : public WebConfigEventStream {
+  public:
+  AsyncWebConfigEventStream(std::shared_ptr<ASYNCEVENTS> events) : _events(events) {}
+  boolean connected() override { return _events->connected; }
+  boolean write(const char* text) override
+  {
+    if (!_events->connected)
+      return false;
+#if defined(ESP32)
+    xSemaphoreTake(_events->lock, portMAX_DELAY);
+#endif
+    _events->pending += text;
+#if defined(ESP32)
+    xSemaphoreGive(_events->lock);
+#endif
+    return true;
+  }
+  private:
+  std::shared_ptr<ASYNCEVENTS> _events;
+};
+
+class AsyncWebConfigTransport : public WebConfigTransport {
+  public:
+  AsyncWebConfigTransport(AsyncWebServerRequest* request) : _request(request) {}
+  int args() override { return _request->args(); }
+  String argName(int i) override { return _request->argName(i); }
+  String arg(int i) override { return _request->arg(i); }
+  String arg(const String& name) override { return _request->arg(name); }
+  boolean hasArg(const String& name) override { return _request->hasArg(name.c_str()); }
+  boolean isPost() override { return _request->method() == HTTP_POST; }
+  void sendHeader(const char* name, const char* value) override
+  {
+    if (_headerCnt < ASYNC_MAXHEADERS)
+    {
+      _headerNames[_headerCnt] = name;
+      _headerValues[_headerCnt] = value;
+      _headerCnt++;
+    }
+  }
+  void send(int code, const char* contentType, WebConfigFiller filler) override
+  {
+    AsyncWebServerResponse* response = _request->beginChunkedResponse(contentType,
+      [filler](uint8_t* buffer, size_t maxLen, size_t index) -> size_t { return filler(buffer, maxLen); });
+    response->setCode(code);
+    for (uint8_t i = 0; i < _headerCnt; i++)
+      response->addHeader(_headerNames[i], _headerValues[i]);
+    _headerCnt = 0;
+    _request->send(response);
+  }
+  //a chunked response which asks the server to try again while no
+  //events are queued
+  WebConfigEventStream* openEvents() override
+  {
+    std::shared_ptr<ASYNCEVENTS> events(new ASYNCEVENTS, [](ASYNCEVENTS* e) {
+#if defined(ESP32)
+      vSemaphoreDelete(e->lock);
+#endif
+      delete e;
+    });
+    events->pending = "retry: 2000\n\n";
+    events->connected = true;
+#if defined(ESP32)
+    events->lock = xSemaphoreCreateMutex();
+#endif
+    AsyncWebServerResponse* response = _request->beginChunkedResponse("text/event-stream",
+      [events](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+#if defined(ESP32)
+        xSemaphoreTake(events->lock, portMAX_DELAY);
+#endif
+        size_t n = events->pending.length();
+        if (n > maxLen)
+          n = maxLen;
+        memcpy(buffer, events->pending.c_str(), n);
+        events->pending.remove(0, n);
+#if defined(ESP32)
+        xSemaphoreGive(events->lock);
+#endif
+        if (n > 0)
+          return n;
+        return events->connected ? RESPONSE_TRY_AGAIN : 0;
+      });
+    response->addHeader("Cache-Control", "no-cache");
+    _request->onDisconnect([events]() { events->connected = false; });
+    _request->send(response);
+    return new AsyncWebConfigEventStream(events);
+  }
+  WebConfigFormState* takeForm() override
+  {
+    ASYNCBODY* body = (ASYNCBODY*)_request->_tempObject;
+    WebConfigFormState* state = body ? body->form : nullptr;
+    if (body)
+      body->form = nullptr;
+    return state;
+  }
+  WebConfigImportState* takeImport() override
+  {
+    ASYNCBODY* body = (ASYNCBODY*)_request->_tempObject;
+    WebConfigImportState* state = body ? body->import : nullptr;
+    if (body)
+      body->import = nullptr;
+    return state;
+  }
+  private:
+  AsyncWebServerRequest* _request;
+  uint8_t _headerCnt = 0;
+  String _headerNames[ASYNC_MAXHEADERS];
+  String _headerValues[ASYNC_MAXHEADERS];
+};
+
+//serve the form of conf at uri and enable write-behind mode with
+//quietMs, so flash is written by conf.loop(). 0 keeps the current mode
+inline void setAsyncServer(WebConfig& conf, AsyncWebServer* server, const char* uri = "/", uint32_t quietMs = 500)
+{
+  if (quietMs > 0)
+    conf.setWriteBehind(quietMs);
+  conf.mount(uri);
+  server->on(uri, HTTP_ANY, [&conf](AsyncWebServerRequest* request) {
+    AsyncWebConfigTransport transport(request);
+    conf.handleFormRequest(&transport);
+  }, nullptr, [&conf](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+    // the body of a restore or a submit is decoded while it is received.
+    // The state belongs to the request, so bodies of concurrent requests
+    // do not mix
+    ASYNCBODY* body = (ASYNCBODY*)request->_tempObject;
+    if (index == 0)
+    {
+      if (body == nullptr)
+      {
+        body = (ASYNCBODY*)calloc(1, sizeof(ASYNCBODY));
+        if (body == nullptr)
+          return;
+        request->_tempObject = body;
+        // states not taken by the request handler are freed
+        request->onDisconnect([request]() {
+          ASYNCBODY* b = (ASYNCBODY*)request->_tempObject;
+          if (b)
+          {
+            WebConfig::discardForm(b->form);
+            WebConfig::discardImport(b->import);
+            b->form = nullptr;
+            b->import = nullptr;
+          }
+        });
+      }
+      if (request->arg("wc") == "import")
+      {
+        body->import = conf.beginImport();
+      }
+      else if (request->arg("wc") == "submit")
+      {
+        AsyncWebConfigTransport transport(request);
+        body->form = conf.beginForm(&transport);
+      }
+    }
+    if (body == nullptr)
+      return;
+    if (body->import)
+      conf.importChunk(body->import, data, len);
+    else if (body->form)
+      conf.formChunk(body->form, data, len);
+  });
+}
+
+//serve the list of all mounted forms at uri
+inline void setAsyncIndex(AsyncWebServer* server, const char* uri = "/")
+{
+  server->on(uri, HTTP_GET, [](AsyncWebServerRequest* request) {
+    AsyncWebConfigTransport transport(request);
+    WebConfig::handleIndex(&transport);
+  });
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*
+File WebConfigNumber.cpp
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+Description
+Conversion of numbers to text and back without String objects
+*/
+
+#include "WebConfigNumber.h"
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// digits are written backwards into a small buffer and copied
+size_t formatInteger(char *buf, long long value)
+{
+  char tmp[24];
+  uint8_t n = 0;
+  size_t len = 0;
+  unsigned long long v = (value < 0) ? 0ULL - (unsigned long long)value : value;
+  do
+  {
+    tmp[n++] = '0' + (v % 10);
+    v /= 10;
+  } while (v > 0);
+  if (value < 0)
+    buf[len++] = '-';
+  while (n > 0)
+    buf[len++] = tmp[--n];
+  buf[len] = 0;
+  return len;
+}
+
+// the precision is increased until the text reads back exactly, a float
+// needs at most 9 and a double at most 17 significant digits
+size_t formatFloat(char *buf, float value)
+{
+  int len = 0;
+  for (int precision = 1; precision <= 9; precision++)
+  {
+    len = snprintf(buf, NUMBERLENGTH, "%.*g", precision, value);
+    if (strtof(buf, nullptr) == value)
+      break;
+  }
+  return len;
+}
+
+size_t formatDouble(char *buf, double value)
+{
+  int len = 0;
+  for (int precision = 1; precision <= 17; precision++)
+  {
+    len = snprintf(buf, NUMBERLENGTH, "%.*g", precision, value);
+    if (strtod(buf, nullptr) == value)
+      break;
+  }
+  return len;
+}
+
+boolean parseInteger(const char *s, long &result)
+{
+  char *end;
+  errno = 0;
+  result = strtol(s, &end, 10);
+  return (end != s) && (*end == 0) && (errno != ERANGE);
+}
+
+boolean parseNumber(const char *s, double &result)
+{
+  char *end;
+  result = strtod(s, &end);
+  return (end != s) && (*end == 0) && isfinite(result);
+}
+
+boolean storedInteger(const char *s, long &result)
+{
+  result = 0;
+  if (*s == 0)
+    return true;
+  if (parseInteger(s, result))
+    return true;
+  result = 0;
+  return false;
+}
+
+boolean storedNumber(const char *s, double &result)
+{
+  result = 0;
+  if (*s == 0)
+    return true;
+  if (parseNumber(s, result))
+    return true;
+  result = 0;
+  return false;
+}
@@ -0,0 +1,38 @@
+/*
+
+File WebConfigNumber.h
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+
+Description
+Conversion of numbers to text and back without String objects. Floats
+are written with the fewest digits which read back as the same value,
+so a value survives any number of saves and loads unchanged. Integers
+are parsed with a range check.
+
+*/
+#ifndef WebConfigNumber_h
+#define WebConfigNumber_h
+
+#include <Arduino.h>
+
+//size of a buffer for every formatted number
+#define NUMBERLENGTH 32
+
+//decimal text of value into buf, returns the length
+size_t formatInteger(char* buf, long long value);
+//shortest text which reads back as the same float or double
+size_t formatFloat(char* buf, float value);
+size_t formatDouble(char* buf, double value);
+//parse a decimal integer, the complete string has to be a number
+//returns false for an empty string or if the number is out of range
+boolean parseInteger(const char* s, long& result);
+//parse a finite number, the complete string has to be a number
+boolean parseNumber(const char* s, double& result);
+//number of a stored value, an empty value is 0
+//returns false with result 0 if the value is no number
+boolean storedInteger(const char* s, long& result);
+boolean storedNumber(const char* s, double& result);
+
+#endif
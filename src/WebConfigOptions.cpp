@@ -0,0 +1,85 @@
+/*
+File WebConfigOptions.cpp
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+Description
+Option providers for large selection lists
+*/
+
+#include "WebConfigOptions.h"
+#include <memory>
+#if defined(ESP32) || defined(ESP8266)
+#include <LittleFS.h>
+#endif
+
+//*************************** LittleFS file **********************************
+#if defined(ESP32) || defined(ESP8266)
+// read position of a file provider, the last option is kept for
+// repeated requests of the same index
+typedef struct
+{
+  String filename;
+  File file;
+  int32_t last;
+  String value;
+  String label;
+} FILEOPTIONS;
+
+static boolean readOption(FILEOPTIONS &fo, uint16_t index)
+{
+  if (index == fo.last)
+    return true;
+  if ((!fo.file) || ((int32_t)index < fo.last))
+  {
+    if (fo.file)
+      fo.file.close();
+    fo.file = LittleFS.open(fo.filename, "r");
+    fo.last = -1;
+    if (!fo.file)
+      return false;
+  }
+  while (fo.last < (int32_t)index)
+  {
+    if (!fo.file.available())
+    {
+      // end of the list, release the file until the next pass
+      fo.file.close();
+      fo.last = -1;
+      return false;
+    }
+    String line = fo.file.readStringUntil(10);
+    line.trim();
+    if (line.length() == 0)
+      continue;
+    int pos = line.indexOf('=');
+    if (pos < 0)
+    {
+      fo.value = line;
+      fo.label = line;
+    }
+    else
+    {
+      fo.value = line.substring(0, pos);
+      fo.label = line.substring(pos + 1);
+    }
+    fo.last++;
+  }
+  return true;
+}
+
+WebConfigOptionProvider fileOptions(const char *filename)
+{
+  std::shared_ptr<FILEOPTIONS> fo = std::make_shared<FILEOPTIONS>();
+  fo->filename = filename;
+  fo->last = -1;
+  return [fo](uint16_t index, String &value, String &label)
+  {
+    if (!readOption(*fo, index))
+      return false;
+    value = fo->value;
+    label = fo->label;
+    return true;
+  };
+}
+#endif
@@ -0,0 +1,38 @@
+/*
+
+File WebConfigOptions.h
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+
+Description
+Option providers for large selection lists. A provider delivers the
+options of a select or radio field by index when the form is rendered
+and when a value is validated, so the list is never held in RAM.
+Available providers:
+  fileOptions      one option per line value=label in a LittleFS file
+                   (ESP32 and ESP8266), the label is optional
+Own providers are functions or lambdas with the signature of
+WebConfigOptionProvider.
+
+*/
+#ifndef WebConfigOptions_h
+#define WebConfigOptions_h
+
+#include <Arduino.h>
+#include <functional>
+
+//longest value or label of a provided option, longer strings are cut
+#define PROVIDERLENGTH 100
+
+//deliver the option with index, returns false if index is past the end
+//options are mostly requested in ascending order, the same index may be
+//requested more than once
+typedef std::function<boolean(uint16_t index, String& value, String& label)> WebConfigOptionProvider;
+
+#if defined(ESP32) || defined(ESP8266)
+//options read from a LittleFS file, the file is read sequentially
+WebConfigOptionProvider fileOptions(const char* filename);
+#endif
+
+#endif
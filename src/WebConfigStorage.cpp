@@ -0,0 +1,697 @@
+/*
+File WebConfigStorage.cpp
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+Description
+Storage backends for the WebConfig configuration data
+The file backends store one line name=value per entry,
+line feeds in values are replaced by ~
+Entries without value (nullptr) are not stored, they keep their default
+*/
+
+#include "WebConfigStorage.h"
+#include "WebConfigNumber.h"
+#include <stdio.h>
+#include <errno.h>
+#if defined(ESP32) || defined(ESP8266)
+#include <LittleFS.h>
+#endif
+#if defined(ESP32) || defined(WEBCONFIG_HOST_NVS)
+#include "Preferences.h"
+#include <nvs.h>
+#endif
+
+// split a line name=value and call the loader
+static void loadLine(String &line, WebConfigLoader loader)
+{
+  int pos = line.indexOf('=');
+  if (pos <= 0)
+    return;
+  line.replace("~", "\n");
+  line.setCharAt(pos, 0);
+  loader(line.c_str(), line.c_str() + pos + 1);
+}
+
+// value with line feeds replaced for a line of a file
+static String lineValue(const char *value)
+{
+  String val = value;
+  val.replace("\n", "~");
+  return val;
+}
+
+//*************************** LittleFS ***************************************
+#if defined(ESP32) || defined(ESP8266)
+// mount LittleFS, format it if it cannot be mounted
+boolean LittleFSStorage::begin()
+{
+  if (!_mounted)
+  {
+    _mounted = LittleFS.begin();
+    if (!_mounted)
+    {
+      LittleFS.format();
+      _mounted = LittleFS.begin();
+    }
+  }
+  return _mounted;
+}
+
+boolean LittleFSStorage::load(const CONFIGENTRY *keys, uint8_t count, WebConfigLoader loader)
+{
+  String line;
+  if (!begin() || !LittleFS.exists(_filename))
+    return false;
+  File f = LittleFS.open(_filename, "r");
+  if (!f)
+    return false;
+  uint32_t size = f.size();
+  while (f.position() < size)
+  {
+    line = f.readStringUntil(10);
+    loadLine(line, loader);
+  }
+  f.close();
+  return true;
+}
+
+boolean LittleFSStorage::store(const CONFIGENTRY *entries, uint8_t count)
+{
+  if (!begin())
+    return false;
+  File f = LittleFS.open(_filename, "w");
+  if (!f)
+    return false;
+  for (uint8_t i = 0; i < count; i++)
+    if (entries[i].value != nullptr)
+      f.printf("%s=%s\n", entries[i].name, lineValue(entries[i].value).c_str());
+  f.close();
+  return true;
+}
+
+boolean LittleFSStorage::remove()
+{
+  return begin() && LittleFS.remove(_filename);
+}
+
+// blobs are stored in files named like the config file with .key appended
+size_t LittleFSStorage::blobSize(const char *key)
+{
+  String name = _filename + "." + key;
+  if (!begin() || !LittleFS.exists(name))
+    return 0;
+  File f = LittleFS.open(name, "r");
+  size_t size = f ? f.size() : 0;
+  f.close();
+  return size;
+}
+
+boolean LittleFSStorage::loadBlob(const char *key, uint8_t *data, size_t len)
+{
+  if (!begin())
+    return false;
+  File f = LittleFS.open(_filename + "." + key, "r");
+  if (!f)
+    return false;
+  boolean ok = f.read(data, len) == len;
+  f.close();
+  return ok;
+}
+
+boolean LittleFSStorage::storeBlob(const char *key, const uint8_t *data, size_t len)
+{
+  if (!begin())
+    return false;
+  File f = LittleFS.open(_filename + "." + key, "w");
+  if (!f)
+    return false;
+  boolean ok = f.write(data, len) == len;
+  f.close();
+  return ok;
+}
+
+boolean LittleFSStorage::removeBlob(const char *key)
+{
+  String name = _filename + "." + key;
+  return begin() && (!LittleFS.exists(name) || LittleFS.remove(name));
+}
+#endif
+
+//*************************** NVS ********************************************
+#if defined(ESP32) || defined(WEBCONFIG_HOST_NVS)
+// one Preferences session for all entries. Floats are doubles, 4 byte
+// floats written by older versions are read as well
+boolean NVSStorage::load(const CONFIGENTRY *keys, uint8_t count, WebConfigLoader loader)
+{
+  Preferences p;
+  char num[NUMBERLENGTH];
+  boolean found = false;
+  if (!p.begin(_nameSpace.c_str(), true))
+    return false;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (!p.isKey(keys[i].name))
+      continue;
+    found = true;
+    switch (keys[i].kind)
+    {
+    case STORE_INT:
+      formatInteger(num, p.getInt(keys[i].name));
+      loader(keys[i].name, num);
+      break;
+    case STORE_FLOAT:
+      if (p.getBytesLength(keys[i].name) == sizeof(double))
+        formatDouble(num, p.getDouble(keys[i].name));
+      else
+        formatFloat(num, p.getFloat(keys[i].name));
+      loader(keys[i].name, num);
+      break;
+    default:
+      loader(keys[i].name, p.getString(keys[i].name).c_str());
+      break;
+    }
+  }
+  p.end();
+  return found;
+}
+
+// previous state of a key, restored if the store fails
+struct NVSUNDO
+{
+  const CONFIGENTRY *entry;
+  boolean existed;
+  int32_t i;
+  //stored float, 4 or 8 bytes
+  uint8_t blob[8];
+  size_t blobLen;
+  String s;
+};
+
+// read the stored value of an entry into u, the types are those of
+// Preferences: i32 for integers, a blob like putDouble() for floats and
+// strings. Returns true if the stored value equals the new one
+// strings are compared as they are. A value which is no number is never
+// equal, so it reaches nvsWrite() which rejects it
+static boolean nvsCurrent(nvs_handle_t h, const CONFIGENTRY &e, NVSUNDO &u)
+{
+  size_t len;
+  double d, v;
+  long n;
+  u.entry = &e;
+  switch (e.kind)
+  {
+  case STORE_INT:
+    u.existed = nvs_get_i32(h, e.name, &u.i) == ESP_OK;
+    return u.existed && (e.value != nullptr) && storedInteger(e.value, n) && (u.i == n);
+  case STORE_FLOAT:
+    // a float of an older version is replaced by a double
+    u.blobLen = sizeof(u.blob);
+    u.existed = nvs_get_blob(h, e.name, u.blob, &u.blobLen) == ESP_OK;
+    memcpy(&d, u.blob, sizeof(d));
+    return u.existed && (e.value != nullptr) && (u.blobLen == sizeof(d)) && storedNumber(e.value, v) && (d == v);
+  default:
+    u.existed = nvs_get_str(h, e.name, nullptr, &len) == ESP_OK;
+    if (u.existed)
+    {
+      char *buf = new char[len];
+      u.existed = nvs_get_str(h, e.name, buf, &len) == ESP_OK;
+      u.s = u.existed ? buf : "";
+      delete[] buf;
+    }
+    return u.existed && (e.value != nullptr) && (u.s == e.value);
+  }
+}
+
+// write a value of kind, nullptr erases the key. A number which does not
+// parse or does not fit into an i32 fails the write, so the commit is
+// rolled back
+static esp_err_t nvsWrite(nvs_handle_t h, const char *name, uint8_t kind, const char *value)
+{
+  double d;
+  long n;
+  if (value == nullptr)
+    return nvs_erase_key(h, name);
+  switch (kind)
+  {
+  case STORE_INT:
+    if (!storedInteger(value, n) || (n < INT32_MIN) || (n > INT32_MAX))
+      return ESP_ERR_INVALID_ARG;
+    return nvs_set_i32(h, name, n);
+  case STORE_FLOAT:
+    if (!storedNumber(value, d))
+      return ESP_ERR_INVALID_ARG;
+    return nvs_set_blob(h, name, &d, sizeof(d));
+  default:
+    return nvs_set_str(h, name, value);
+  }
+}
+
+// write the previous state of a key back
+static void nvsRestore(nvs_handle_t h, const NVSUNDO &u)
+{
+  const char *name = u.entry->name;
+  if (!u.existed)
+    nvs_erase_key(h, name);
+  else if (u.entry->kind == STORE_INT)
+    nvs_set_i32(h, name, u.i);
+  else if (u.entry->kind == STORE_FLOAT)
+    nvs_set_blob(h, name, u.blob, u.blobLen);
+  else
+    nvs_set_str(h, name, u.s.c_str());
+}
+
+// one NVS handle and one commit for all entries. Unchanged keys are not
+// written at all
+boolean NVSStorage::store(const CONFIGENTRY *entries, uint8_t count)
+{
+  nvs_handle_t h;
+  uint32_t start = micros();
+  _writes = 0;
+  if (nvs_open(_nameSpace.c_str(), NVS_READWRITE, &h) != ESP_OK)
+  {
+    Serial.println(F("Cannot write configuration to nvs "));
+    return false;
+  }
+  NVSUNDO *undo = new NVSUNDO[count];
+  uint8_t written = 0;
+  esp_err_t err = ESP_OK;
+  for (uint8_t i = 0; (i < count) && (err == ESP_OK); i++)
+  {
+    NVSUNDO &u = undo[written];
+    if (nvsCurrent(h, entries[i], u) || ((entries[i].value == nullptr) && !u.existed))
+      continue;
+    err = nvsWrite(h, entries[i].name, entries[i].kind, entries[i].value);
+    // a failed write keeps the old value, only successful writes are undone
+    if (err == ESP_OK)
+      written++;
+  }
+  if ((err == ESP_OK) && (written > 0))
+    err = nvs_commit(h);
+  if (err != ESP_OK)
+  {
+    Serial.printf("NVS write failed (%s), rollback of %u keys\n", esp_err_to_name(err), written);
+    while (written > 0)
+      nvsRestore(h, undo[--written]);
+    nvs_commit(h);
+  }
+  else
+  {
+    _writes = written;
+  }
+  nvs_close(h);
+  delete[] undo;
+  _commitTime = micros() - start;
+  return err == ESP_OK;
+}
+
+boolean NVSStorage::remove()
+{
+  Preferences p;
+  if (!p.begin(_nameSpace.c_str(), false))
+    return false;
+  boolean ok = p.clear();
+  p.end();
+  return ok;
+}
+
+size_t NVSStorage::blobSize(const char *key)
+{
+  Preferences p;
+  size_t size = 0;
+  if (p.begin(_nameSpace.c_str(), true))
+  {
+    if (p.isKey(key))
+      size = p.getBytesLength(key);
+    p.end();
+  }
+  return size;
+}
+
+boolean NVSStorage::loadBlob(const char *key, uint8_t *data, size_t len)
+{
+  Preferences p;
+  if (!p.begin(_nameSpace.c_str(), true))
+    return false;
+  boolean ok = p.getBytes(key, data, len) == len;
+  p.end();
+  return ok;
+}
+
+boolean NVSStorage::storeBlob(const char *key, const uint8_t *data, size_t len)
+{
+  Preferences p;
+  if (!p.begin(_nameSpace.c_str(), false))
+    return false;
+  boolean ok = p.putBytes(key, data, len) == len;
+  p.end();
+  return ok;
+}
+
+boolean NVSStorage::removeBlob(const char *key)
+{
+  Preferences p;
+  if (!p.begin(_nameSpace.c_str(), false))
+    return false;
+  boolean ok = !p.isKey(key) || p.remove(key);
+  p.end();
+  return ok;
+}
+#endif
+
+//*************************** RAM ********************************************
+RAMStorage::~RAMStorage()
+{
+  remove();
+  while (_blobs != nullptr)
+  {
+    BLOB *b = _blobs;
+    _blobs = b->next;
+    delete[] b->data;
+    delete b;
+  }
+}
+
+boolean RAMStorage::load(const CONFIGENTRY *keys, uint8_t count, WebConfigLoader loader)
+{
+  if (_names == nullptr)
+    return false;
+  for (uint8_t i = 0; i < _count; i++)
+    loader(_names[i].c_str(), _values[i].c_str());
+  return true;
+}
+
+boolean RAMStorage::store(const CONFIGENTRY *entries, uint8_t count)
+{
+  remove();
+  _names = new String[count];
+  _values = new String[count];
+  _count = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (entries[i].value == nullptr)
+      continue;
+    _names[_count] = entries[i].name;
+    _values[_count] = entries[i].value;
+    _count++;
+  }
+  return true;
+}
+
+boolean RAMStorage::remove()
+{
+  delete[] _names;
+  delete[] _values;
+  _names = nullptr;
+  _values = nullptr;
+  _count = 0;
+  return true;
+}
+
+RAMStorage::BLOB *RAMStorage::findBlob(const char *key)
+{
+  for (BLOB *b = _blobs; b != nullptr; b = b->next)
+  {
+    if (b->key == key)
+      return b;
+  }
+  return nullptr;
+}
+
+size_t RAMStorage::blobSize(const char *key)
+{
+  BLOB *b = findBlob(key);
+  return (b != nullptr) ? b->len : 0;
+}
+
+boolean RAMStorage::loadBlob(const char *key, uint8_t *data, size_t len)
+{
+  BLOB *b = findBlob(key);
+  if ((b == nullptr) || (b->len != len))
+    return false;
+  memcpy(data, b->data, len);
+  return true;
+}
+
+boolean RAMStorage::storeBlob(const char *key, const uint8_t *data, size_t len)
+{
+  BLOB *b = findBlob(key);
+  if (b == nullptr)
+  {
+    b = new BLOB;
+    b->key = key;
+    b->next = _blobs;
+    _blobs = b;
+  }
+  else
+  {
+    delete[] b->data;
+  }
+  b->data = new uint8_t[len];
+  memcpy(b->data, data, len);
+  b->len = len;
+  return true;
+}
+
+boolean RAMStorage::removeBlob(const char *key)
+{
+  BLOB **b = &_blobs;
+  while ((*b != nullptr) && ((*b)->key != key))
+    b = &(*b)->next;
+  if (*b != nullptr)
+  {
+    BLOB *old = *b;
+    *b = old->next;
+    delete[] old->data;
+    delete old;
+  }
+  return true;
+}
+
+//*************************** POSIX ******************************************
+boolean PosixStorage::load(const CONFIGENTRY *keys, uint8_t count, WebConfigLoader loader)
+{
+  String line;
+  int c;
+  FILE *f = fopen(_path.c_str(), "r");
+  if (f == nullptr)
+    return false;
+  while ((c = fgetc(f)) != EOF)
+  {
+    if (c == '\n')
+    {
+      loadLine(line, loader);
+      line = "";
+    }
+    else
+    {
+      line += (char)c;
+    }
+  }
+  loadLine(line, loader);
+  fclose(f);
+  return true;
+}
+
+// write a temporary file and replace the config, a failed write
+// keeps the old config
+boolean PosixStorage::store(const CONFIGENTRY *entries, uint8_t count)
+{
+  String tmp = _path + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "w");
+  if (f == nullptr)
+    return false;
+  boolean ok = true;
+  for (uint8_t i = 0; i < count; i++)
+    if (entries[i].value != nullptr)
+      ok &= fprintf(f, "%s=%s\n", entries[i].name, lineValue(entries[i].value).c_str()) > 0;
+  ok &= fclose(f) == 0;
+  if (ok && (rename(tmp.c_str(), _path.c_str()) != 0))
+  {
+    // some file systems do not replace existing files
+    ::remove(_path.c_str());
+    ok = rename(tmp.c_str(), _path.c_str()) == 0;
+  }
+  if (!ok)
+    ::remove(tmp.c_str());
+  return ok;
+}
+
+boolean PosixStorage::remove()
+{
+  return ::remove(_path.c_str()) == 0;
+}
+
+// blobs are stored in files named like the config file with .key appended
+size_t PosixStorage::blobSize(const char *key)
+{
+  String name = _path + "." + key;
+  FILE *f = fopen(name.c_str(), "rb");
+  if (f == nullptr)
+    return 0;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fclose(f);
+  return (size > 0) ? size : 0;
+}
+
+boolean PosixStorage::loadBlob(const char *key, uint8_t *data, size_t len)
+{
+  String name = _path + "." + key;
+  FILE *f = fopen(name.c_str(), "rb");
+  if (f == nullptr)
+    return false;
+  boolean ok = fread(data, 1, len, f) == len;
+  fclose(f);
+  return ok;
+}
+
+boolean PosixStorage::storeBlob(const char *key, const uint8_t *data, size_t len)
+{
+  String name = _path + "." + key;
+  FILE *f = fopen(name.c_str(), "wb");
+  if (f == nullptr)
+    return false;
+  boolean ok = fwrite(data, 1, len, f) == len;
+  ok &= fclose(f) == 0;
+  return ok;
+}
+
+boolean PosixStorage::removeBlob(const char *key)
+{
+  String name = _path + "." + key;
+  return (::remove(name.c_str()) == 0) || (errno == ENOENT);
+}
+
+//*************************** NVS CSV ****************************************
+// CSV line of a field as expected by nvs_partition_gen.py
+// strings are quoted, floats are blobs like Preferences::putDouble writes.
+// Returns an empty line for a number which does not parse
+static String csvLine(const char *key, const char *value, uint8_t kind)
+{
+  String line = key;
+  long n;
+  double d;
+  switch (kind)
+  {
+  case STORE_INT:
+  {
+    char num[NUMBERLENGTH];
+    if (!storedInteger(value, n) || (n < INT32_MIN) || (n > INT32_MAX))
+      return String();
+    formatInteger(num, n);
+    line += ",data,i32,";
+    line += num;
+    break;
+  }
+  case STORE_FLOAT:
+  {
+    // little endian like on the ESP32
+    if (!storedNumber(value, d))
+      return String();
+    char hex[2 * sizeof(d) + 1];
+    const uint8_t *b = (const uint8_t *)&d;
+    for (uint8_t i = 0; i < sizeof(d); i++)
+      snprintf(hex + 2 * i, sizeof(hex) - 2 * i, "%02x", b[i]);
+    line += ",data,hex2bin,";
+    line += hex;
+    break;
+  }
+  default:
+  {
+    String val = value;
+    val.replace("\"", "\"\"");
+    line += ",data,string,\"";
+    line += val;
+    line += '"';
+    break;
+  }
+  }
+  line += '\n';
+  return line;
+}
+
+NVSCsvStorage::~NVSCsvStorage()
+{
+  while (_blobs != nullptr)
+  {
+    BLOB *b = _blobs;
+    _blobs = b->next;
+    delete b;
+  }
+}
+
+boolean NVSCsvStorage::store(const CONFIGENTRY *entries, uint8_t count)
+{
+  String line;
+  _entries = "";
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (entries[i].value == nullptr)
+      continue;
+    // a number which does not parse keeps the file unchanged
+    line = csvLine(entries[i].name, entries[i].value, entries[i].kind);
+    if (line.length() == 0)
+      return false;
+    _entries += line;
+  }
+  return write();
+}
+
+boolean NVSCsvStorage::storeBlob(const char *key, const uint8_t *data, size_t len)
+{
+  BLOB *b = _blobs;
+  while ((b != nullptr) && (b->key != key))
+    b = b->next;
+  if (b == nullptr)
+  {
+    b = new BLOB;
+    b->key = key;
+    b->next = _blobs;
+    _blobs = b;
+  }
+  char hex[4];
+  b->line = key;
+  b->line += ",data,hex2bin,";
+  b->line.reserve(b->line.length() + 2 * len + 1);
+  for (size_t i = 0; i < len; i++)
+  {
+    snprintf(hex, sizeof(hex), "%02x", data[i]);
+    b->line += hex;
+  }
+  b->line += '\n';
+  return write();
+}
+
+// the line of the blob is dropped from the image
+boolean NVSCsvStorage::removeBlob(const char *key)
+{
+  BLOB **b = &_blobs;
+  while ((*b != nullptr) && ((*b)->key != key))
+    b = &(*b)->next;
+  if (*b == nullptr)
+    return true;
+  BLOB *old = *b;
+  *b = old->next;
+  delete old;
+  return write();
+}
+
+boolean NVSCsvStorage::remove()
+{
+  return ::remove(_path.c_str()) == 0;
+}
+
+// the CSV is written completely with every change
+boolean NVSCsvStorage::write()
+{
+  FILE *f = fopen(_path.c_str(), "w");
+  if (f == nullptr)
+    return false;
+  boolean ok = fprintf(f, "key,type,encoding,value\n%s,namespace,,\n", _nameSpace.c_str()) > 0;
+  ok &= fputs(_entries.c_str(), f) >= 0;
+  for (BLOB *b = _blobs; b != nullptr; b = b->next)
+    ok &= fputs(b->line.c_str(), f) >= 0;
+  ok &= fclose(f) == 0;
+  return ok;
+}
@@ -0,0 +1,180 @@
+/*
+
+File WebConfigStorage.h
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+
+Description
+Storage backends for the WebConfig configuration data.
+A backend loads, stores and deletes the complete configuration
+with one call. Available backends:
+  LittleFSStorage  file in LittleFS (ESP32 and ESP8266)
+  NVSStorage       namespace in the NVS (ESP32), on a host with
+                   WEBCONFIG_HOST_NVS against the NVS emulation of the
+                   host tests
+  RAMStorage       kept in RAM only, lost on restart
+  PosixStorage     file accessed with stdio, e.g. on a Linux host or
+                   on ESP32 with a VFS path like /littlefs/WebConf.conf
+  NVSCsvStorage    CSV file for the NVS partition generator of ESP-IDF,
+                   to create NVS images on a host
+Own backends are derived from WebConfigStorage.
+
+*/
+#ifndef WebConfigStorage_h
+#define WebConfigStorage_h
+
+#include <Arduino.h>
+#include <functional>
+
+//how a value should be stored, backends may store numbers natively
+#define STORE_STRING 0
+#define STORE_INT 1
+#define STORE_FLOAT 2
+
+//one configuration entry
+typedef struct {
+  const char* name;
+  const char* value;
+  uint8_t kind;
+} CONFIGENTRY;
+
+//callback for every entry found by load()
+typedef std::function<void(const char* name, const char* value)> WebConfigLoader;
+
+class WebConfigStorage {
+  public:
+  virtual ~WebConfigStorage() {}
+  //prepare the storage, e.g. mount the file system
+  virtual boolean begin() { return true; }
+  //read the stored config. keys holds the names and kinds of the expected
+  //entries, loader is called for every entry found in the storage
+  //returns false if there is no stored config
+  virtual boolean load(const CONFIGENTRY* keys, uint8_t count, WebConfigLoader loader) = 0;
+  //replace the stored config by count entries
+  //entries with value nullptr are removed from the storage
+  virtual boolean store(const CONFIGENTRY* entries, uint8_t count) = 0;
+  //delete the stored config
+  virtual boolean remove() = 0;
+  //maximum length of an entry name
+  virtual uint8_t maxNameLength() { return 255; }
+  //binary blobs stored beside the config, e.g. the schema cache
+  //backends without blob support keep the default implementation
+  //size of the blob key, 0 if it does not exist
+  virtual size_t blobSize(const char* key) { return 0; }
+  virtual boolean loadBlob(const char* key, uint8_t* data, size_t len) { return false; }
+  virtual boolean storeBlob(const char* key, const uint8_t* data, size_t len) { return false; }
+  //delete the blob key, a blob which does not exist counts as deleted
+  virtual boolean removeBlob(const char* key) { return false; }
+};
+
+#if defined(ESP32) || defined(ESP8266)
+class LittleFSStorage : public WebConfigStorage {
+  public:
+  LittleFSStorage(const char* filename) : _filename(filename) {}
+  boolean begin() override;
+  boolean load(const CONFIGENTRY* keys, uint8_t count, WebConfigLoader loader) override;
+  boolean store(const CONFIGENTRY* entries, uint8_t count) override;
+  boolean remove() override;
+  size_t blobSize(const char* key) override;
+  boolean loadBlob(const char* key, uint8_t* data, size_t len) override;
+  boolean storeBlob(const char* key, const uint8_t* data, size_t len) override;
+  boolean removeBlob(const char* key) override;
+  private:
+  String _filename;
+  boolean _mounted = false;
+};
+#endif
+
+#if defined(ESP32) || defined(WEBCONFIG_HOST_NVS)
+class NVSStorage : public WebConfigStorage {
+  public:
+  NVSStorage(const char* nameSpace) : _nameSpace(nameSpace) {}
+  boolean load(const CONFIGENTRY* keys, uint8_t count, WebConfigLoader loader) override;
+  //writes the changed keys with one commit, on failure the keys already
+  //written get their previous values back
+  boolean store(const CONFIGENTRY* entries, uint8_t count) override;
+  boolean remove() override;
+  //NVS keys are limited to 15 characters
+  uint8_t maxNameLength() override { return 15; }
+  size_t blobSize(const char* key) override;
+  boolean loadBlob(const char* key, uint8_t* data, size_t len) override;
+  boolean storeBlob(const char* key, const uint8_t* data, size_t len) override;
+  boolean removeBlob(const char* key) override;
+  //duration of the last store() in microseconds including the commit
+  uint32_t getCommitTime() { return _commitTime; }
+  //number of keys written or removed by the last store()
+  uint8_t getWriteCount() { return _writes; }
+  private:
+  String _nameSpace;
+  uint32_t _commitTime = 0;
+  uint8_t _writes = 0;
+};
+#endif
+
+class RAMStorage : public WebConfigStorage {
+  public:
+  ~RAMStorage();
+  boolean load(const CONFIGENTRY* keys, uint8_t count, WebConfigLoader loader) override;
+  boolean store(const CONFIGENTRY* entries, uint8_t count) override;
+  boolean remove() override;
+  size_t blobSize(const char* key) override;
+  boolean loadBlob(const char* key, uint8_t* data, size_t len) override;
+  boolean storeBlob(const char* key, const uint8_t* data, size_t len) override;
+  boolean removeBlob(const char* key) override;
+  private:
+  String* _names = nullptr;
+  String* _values = nullptr;
+  uint8_t _count = 0;
+  struct BLOB {
+    String key;
+    uint8_t* data;
+    size_t len;
+    BLOB* next;
+  };
+  BLOB* _blobs = nullptr;
+  BLOB* findBlob(const char* key);
+};
+
+class PosixStorage : public WebConfigStorage {
+  public:
+  PosixStorage(const char* path) : _path(path) {}
+  boolean load(const CONFIGENTRY* keys, uint8_t count, WebConfigLoader loader) override;
+  boolean store(const CONFIGENTRY* entries, uint8_t count) override;
+  boolean remove() override;
+  size_t blobSize(const char* key) override;
+  boolean loadBlob(const char* key, uint8_t* data, size_t len) override;
+  boolean storeBlob(const char* key, const uint8_t* data, size_t len) override;
+  boolean removeBlob(const char* key) override;
+  private:
+  String _path;
+};
+
+//write only backend, writes the entries in the CSV format of
+//nvs_partition_gen.py with the types NVSStorage uses
+class NVSCsvStorage : public WebConfigStorage {
+  public:
+  NVSCsvStorage(const char* path, const char* nameSpace) : _path(path), _nameSpace(nameSpace) {}
+  ~NVSCsvStorage();
+  //the image is not read back, there is never a stored config
+  boolean load(const CONFIGENTRY* keys, uint8_t count, WebConfigLoader loader) override { return false; }
+  boolean store(const CONFIGENTRY* entries, uint8_t count) override;
+  boolean remove() override;
+  uint8_t maxNameLength() override { return 15; }
+  boolean storeBlob(const char* key, const uint8_t* data, size_t len) override;
+  boolean removeBlob(const char* key) override;
+  private:
+  String _path;
+  String _nameSpace;
+  //CSV lines of the entries and of the blobs
+  String _entries;
+  struct BLOB {
+    String key;
+    String line;
+    BLOB* next;
+  };
+  BLOB* _blobs = nullptr;
+  boolean write();
+};
+
+#endif
@@ -0,0 +1,321 @@
+/*
+File WebConfigTransport.cpp
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+Description
+Web server adapters for WebConfig
+*/
+
+#include "WebConfigTransport.h"
+
+// a transport without access to the stored body passes a copy
+boolean WebConfigTransport::readBody(WebConfigBodySink sink)
+{
+  if (!hasArg(F("plain")))
+    return false;
+  String body = arg(F("plain"));
+  sink((const uint8_t *)body.c_str(), body.length());
+  return true;
+}
+
+#if defined(WEBCONFIG_WEBSERVER)
+void WebServerTransport::sendHeader(const char *name, const char *value)
+{
+#if defined(ESP32)
+  if (_slice > 0)
+  {
+    _headers += String(name) + ": " + value + "\r\n";
+    return;
+  }
+#endif
+  _server->sendHeader(name, value);
+}
+
+#if defined(ESP32)
+// reason phrase of the status line for the codes used by WebConfig
+static const char *reasonPhrase(int code)
+{
+  switch (code)
+  {
+  case 200:
+    return "OK";
+  case 400:
+    return "Bad Request";
+  case 404:
+    return "Not Found";
+  case 405:
+    return "Method Not Allowed";
+  case 409:
+    return "Conflict";
+  case 413:
+    return "Payload Too Large";
+  case 422:
+    return "Unprocessable Entity";
+  case 500:
+    return "Internal Server Error";
+  case 503:
+    return "Service Unavailable";
+  default:
+    return (code < 400) ? "OK" : "Error";
+  }
+}
+#endif
+
+// send a response, the body is sent as chunked transfer encoding
+void WebServerTransport::send(int code, const char *contentType, WebConfigFiller filler)
+{
+  uint8_t buf[CHUNKSIZE];
+  size_t n;
+#if defined(ESP32)
+  if (_slice > 0)
+  {
+    // complete a pending sliced response first
+    while (isPending())
+      loop();
+    // answer directly on the socket and continue in loop()
+    // the socket stays open as long as _client holds it
+    _client = _server->client();
+    _client.printf("HTTP/1.1 %i %s\r\nContent-Type: %s\r\n%sConnection: close\r\n\r\n", code, reasonPhrase(code), contentType,
+                   _headers.c_str());
+    _headers = "";
+    _pending = filler;
+    loop();
+    return;
+  }
+#endif
+  _server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+  _server->send(code, contentType, "");
+  while ((n = filler(buf, CHUNKSIZE)) > 0)
+    _server->sendContent((const char *)buf, n);
+}
+
+#if defined(ESP32)
+// event stream written directly to the socket of the request
+class ClientEventStream : public WebConfigEventStream
+{
+public:
+  ClientEventStream(WiFiClient client) : _client(client) {}
+  ~ClientEventStream() { _client.stop(); }
+  boolean connected() override { return _client.connected(); }
+  boolean write(const char *text) override
+  {
+    size_t len = strlen(text);
+    return connected() && (_client.write((const uint8_t *)text, len) == len);
+  }
+
+private:
+  WiFiClient _client;
+};
+#endif
+
+WebConfigEventStream *WebServerTransport::openEvents()
+{
+#if defined(ESP32)
+  // the socket stays open as long as the stream holds the client
+  ClientEventStream *stream = new ClientEventStream(_server->client());
+  stream->write("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                "Cache-Control: no-cache\r\nConnection: keep-alive\r\n\r\n"
+                "retry: 2000\n\n");
+  return stream;
+#else
+  return nullptr;
+#endif
+}
+
+// send the next slice of a pending response
+void WebServerTransport::loop()
+{
+#if defined(ESP32)
+  uint8_t buf[CHUNKSIZE];
+  size_t n = 0;
+  if (!_pending)
+    return;
+  if (_client.connected())
+  {
+    uint16_t sent = 0;
+    while (sent < _slice)
+    {
+      n = _pending(buf, ((_slice - sent) < CHUNKSIZE) ? (_slice - sent) : CHUNKSIZE);
+      if (n == 0)
+        break;
+      _client.write(buf, n);
+      sent += n;
+    }
+    if (n > 0)
+      return;
+  }
+  _client.stop();
+  _pending = nullptr;
+#endif
+}
+
+// true while a sliced response is pending
+boolean WebServerTransport::isPending()
+{
+#if defined(ESP32)
+  return (bool)_pending;
+#else
+  return false;
+#endif
+}
+
+// ESP8266WebServer returns a reference to the stored body. The WebServer
+// of the ESP32 returns arguments as copies, the body is held twice
+// while it is decoded
+boolean WebServerTransport::readBody(WebConfigBodySink sink)
+{
+  if (!_server->hasArg(F("plain")))
+    return false;
+#if defined(ESP8266)
+  const String &body = _server->arg(F("plain"));
+#else
+  String body = _server->arg(F("plain"));
+#endif
+  sink((const uint8_t *)body.c_str(), body.length());
+  return true;
+}
+#endif
+
+// value of a hex digit, -1 if c is no hex digit
+static int hexValue(char c)
+{
+  if ((c >= '0') && (c <= '9'))
+    return c - '0';
+  if ((c >= 'a') && (c <= 'f'))
+    return c - 'a' + 10;
+  if ((c >= 'A') && (c <= 'F'))
+    return c - 'A' + 10;
+  return -1;
+}
+
+// decode len characters of an urlencoded string
+static String urlDecode(const char *s, size_t len)
+{
+  String res;
+  res.reserve(len);
+  for (size_t i = 0; i < len; i++)
+  {
+    if (s[i] == '+')
+    {
+      res += ' ';
+    }
+    else if ((s[i] == '%') && (i + 2 < len) && (hexValue(s[i + 1]) >= 0) && (hexValue(s[i + 2]) >= 0))
+    {
+      res += (char)((hexValue(s[i + 1]) << 4) | hexValue(s[i + 2]));
+      i += 2;
+    }
+    else
+    {
+      res += s[i];
+    }
+  }
+  return res;
+}
+
+// add an argument to the request
+boolean WebConfigLocalTransport::addArg(const String &name, const String &value)
+{
+  if (_argCnt >= LOCAL_MAXARGS)
+    return false;
+  _names[_argCnt] = name;
+  _values[_argCnt] = value;
+  _argCnt++;
+  return true;
+}
+
+// add the arguments from an urlencoded query string or form body
+void WebConfigLocalTransport::parseArgs(const char *urlencoded)
+{
+  const char *p = urlencoded;
+  while (*p != 0)
+  {
+    const char *end = strchr(p, '&');
+    if (end == nullptr)
+      end = p + strlen(p);
+    const char *eq = (const char *)memchr(p, '=', end - p);
+    if (eq == nullptr)
+      addArg(urlDecode(p, end - p), "");
+    else
+      addArg(urlDecode(p, eq - p), urlDecode(eq + 1, end - eq - 1));
+    p = (*end == '&') ? end + 1 : end;
+  }
+}
+
+// remove arguments and response
+void WebConfigLocalTransport::clear()
+{
+  _argCnt = 0;
+  post = false;
+  code = 0;
+  contentType = "";
+  headers = "";
+  body = "";
+  chunks = 0;
+}
+
+String WebConfigLocalTransport::argName(int i)
+{
+  return (i < _argCnt) ? _names[i] : String();
+}
+
+String WebConfigLocalTransport::arg(int i)
+{
+  return (i < _argCnt) ? _values[i] : String();
+}
+
+String WebConfigLocalTransport::arg(const String &name)
+{
+  for (uint8_t i = 0; i < _argCnt; i++)
+  {
+    if (_names[i] == name)
+      return _values[i];
+  }
+  return String();
+}
+
+// the stored body is passed without a copy
+boolean WebConfigLocalTransport::readBody(WebConfigBodySink sink)
+{
+  for (uint8_t i = 0; i < _argCnt; i++)
+  {
+    if (_names[i] == "plain")
+    {
+      sink((const uint8_t *)_values[i].c_str(), _values[i].length());
+      return true;
+    }
+  }
+  return false;
+}
+
+boolean WebConfigLocalTransport::hasArg(const String &name)
+{
+  for (uint8_t i = 0; i < _argCnt; i++)
+  {
+    if (_names[i] == name)
+      return true;
+  }
+  return false;
+}
+
+void WebConfigLocalTransport::sendHeader(const char *name, const char *value)
+{
+  headers += String(name) + ": " + value + "\n";
+}
+
+// pull the complete body in chunks of chunkSize bytes
+void WebConfigLocalTransport::send(int code, const char *contentType, WebConfigFiller filler)
+{
+  uint8_t buf[CHUNKSIZE];
+  size_t n;
+  size_t max = ((chunkSize > 0) && (chunkSize < CHUNKSIZE)) ? chunkSize : CHUNKSIZE;
+  this->code = code;
+  this->contentType = contentType;
+  body = "";
+  chunks = 0;
+  while ((n = filler(buf, max)) > 0)
+  {
+    body.concat((const char *)buf, n);
+    chunks++;
+  }
+}
@@ -0,0 +1,157 @@
+/*
+
+File WebConfigTransport.h
+Version 1.4
+Author Gerald Lechner
+contakt lechge@gmail.com
+
+Description
+Abstraction of the web server used by WebConfig to receive form
+requests and to send the form. WebServerTransport adapts the
+synchronous WebServer (ESP32) or ESP8266WebServer, WebConfigLocalTransport
+is an in-memory stand-in to exercise the form without a network.
+The adapter for ESPAsyncWebServer is in WebConfigAsync.h
+
+*/
+#ifndef WebConfigTransport_h
+#define WebConfigTransport_h
+
+#include <Arduino.h>
+#include <functional>
+
+#if defined(ESP32)
+#include <WebServer.h>
+#elif defined(ESP8266)
+#include <ESP8266WebServer.h>
+typedef ESP8266WebServer WebServer;
+#endif
+
+#if defined(ESP32) || defined(ESP8266)
+#define WEBCONFIG_WEBSERVER
+#endif
+
+//maximum number of arguments of the local transport
+#define LOCAL_MAXARGS 64
+
+//size of the chunks pulled from the form renderer
+#define CHUNKSIZE 256
+
+//callback to fill buffer with the next part of a response body
+//returns the number of bytes, 0 at the end of the body
+typedef std::function<size_t(uint8_t* buffer, size_t maxLen)> WebConfigFiller;
+
+//callback receiving an unparsed request body
+typedef std::function<void(const uint8_t* data, size_t len)> WebConfigBodySink;
+
+//stream of server-sent events, kept open after the request was handled
+class WebConfigEventStream {
+  public:
+  virtual ~WebConfigEventStream() {}
+  //false after the client has closed the connection
+  virtual boolean connected() = 0;
+  //send raw event text, returns false if the client is gone
+  virtual boolean write(const char* text) = 0;
+};
+
+//decoder states of a form body and of a restore, defined in WebConfig.cpp
+struct WebConfigFormState;
+struct WebConfigImportState;
+
+class WebConfigTransport {
+  public:
+  virtual ~WebConfigTransport() {}
+  //arguments of the current request
+  virtual int args() = 0;
+  virtual String argName(int i) = 0;
+  virtual String arg(int i) = 0;
+  virtual String arg(const String& name) = 0;
+  virtual boolean hasArg(const String& name) = 0;
+  //true for a POST request, requests which change the state like a
+  //profile switch are only accepted with POST
+  virtual boolean isPost() { return false; }
+  //pass the unparsed body (argument plain) to sink, without a copy where
+  //the server hands out a reference. false if the request has no body
+  virtual boolean readBody(WebConfigBodySink sink);
+  //add a header to the next response, must be called before send()
+  virtual void sendHeader(const char* name, const char* value) {}
+  //send a response, the body is pulled from filler until it returns 0
+  virtual void send(int code, const char* contentType, WebConfigFiller filler) = 0;
+  //answer with an event stream, nullptr if the transport cannot keep
+  //the connection open
+  virtual WebConfigEventStream* openEvents() { return nullptr; }
+  //body of the request decoded while it was received, the caller takes
+  //the ownership. nullptr if the body was not decoded
+  virtual WebConfigFormState* takeForm() { return nullptr; }
+  virtual WebConfigImportState* takeImport() { return nullptr; }
+};
+
+#if defined(WEBCONFIG_WEBSERVER)
+class WebServerTransport : public WebConfigTransport {
+  public:
+  WebServerTransport(WebServer* server) : _server(server) {}
+  WebServer* getServer() { return _server; }
+  int args() override { return _server->args(); }
+  String argName(int i) override { return _server->argName(i); }
+  String arg(int i) override { return _server->arg(i); }
+  String arg(const String& name) override { return _server->arg(name); }
+  boolean hasArg(const String& name) override { return _server->hasArg(name); }
+  boolean isPost() override { return _server->method() == HTTP_POST; }
+  boolean readBody(WebConfigBodySink sink) override;
+  void sendHeader(const char* name, const char* value) override;
+  void send(int code, const char* contentType, WebConfigFiller filler) override;
+  //event streams hold the socket of the request, only on ESP32
+  WebConfigEventStream* openEvents() override;
+  //send responses in slices of at most bytes per loop() call, 0 = at once
+  void setSlice(uint16_t bytes) { _slice = bytes; }
+  //send the next slice of a pending response
+  void loop();
+  //true while a sliced response is pending
+  boolean isPending();
+  private:
+  WebServer* _server;
+  uint16_t _slice = 0;
+#if defined(ESP32)
+  //headers of a sliced response, written directly to the socket
+  String _headers;
+  WiFiClient _client;
+  WebConfigFiller _pending{ nullptr };
+#endif
+};
+#endif
+
+class WebConfigLocalTransport : public WebConfigTransport {
+  public:
+  //add an argument to the request
+  boolean addArg(const String& name, const String& value);
+  //add the arguments from an urlencoded query string or form body
+  void parseArgs(const char* urlencoded);
+  //remove arguments and response
+  void clear();
+  int args() override { return _argCnt; }
+  String argName(int i) override;
+  String arg(int i) override;
+  String arg(const String& name) override;
+  boolean hasArg(const String& name) override;
+  boolean isPost() override { return post; }
+  boolean readBody(WebConfigBodySink sink) override;
+  //collect the headers as lines name: value
+  void sendHeader(const char* name, const char* value) override;
+  //pull the complete body in chunks of chunkSize bytes
+  void send(int code, const char* contentType, WebConfigFiller filler) override;
+  //size of the chunks pulled by send()
+  size_t chunkSize = CHUNKSIZE;
+  //method of the request, true for POST
+  boolean post = false;
+  //the last response
+  int code = 0;
+  String contentType;
+  String headers;
+  String body;
+  uint16_t chunks = 0;
+  private:
+  uint8_t _argCnt = 0;
+  String _names[LOCAL_MAXARGS];
+  String _values[LOCAL_MAXARGS];
+};
+
+#endif